@@ -0,0 +1,331 @@
+// Measures the cost of the logging, tracing and assertion macros, per call and under contention
+//
+// usage: bench [--threads=1,2,4,...] [--iters=N] [--filter=TEXT] [--file=PATH] [--format=table|csv|json]
+//
+// Lines go to a sink that discards them (or to a `FileSink` at PATH), so the numbers cover
+// filtering, formatting, rendering and sink dispatch but not the terminal
+
+#include "zlog/log.hpp"
+#include "zlog/sink.hpp"
+#include "zlog/test.hpp"
+#include "zlog/tools.hpp"
+#include "zlog/trace.hpp"
+
+#include <new>
+#include <latch>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <string_view>
+
+// Every allocation of the process is counted for the thread making it
+namespace {
+
+thread_local uint64_t s_allocs = 0;
+
+} // namespace
+
+void *operator new(size_t size)
+{
+    ++s_allocs;
+    if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc{};
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+// Out of line so the compiler does not pair the inlined `free` with `operator new`
+[[gnu::noinline]] void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr) noexcept { operator delete(ptr); }
+void operator delete(void *ptr, size_t) noexcept { operator delete(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { operator delete(ptr); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Format { Table, Csv, Json };
+
+struct Options {
+    std::vector<uint32_t> threads {1, 2, 4, 8, 16, 32, 64};
+    uint64_t              iters   {20'000};  //< Calls per thread and pass
+    std::string_view      filter  {};        //< Run only cases whose name contains this
+    const char           *file    {nullptr};
+    Format                format  {Format::Table};
+};
+
+// Accepts every line and drops it
+class DiscardSink final : public zlog::Sink {
+public:
+    std::atomic<uint64_t> bytes {0};
+
+    void write(const zlog::LogRecord &record) override
+    {
+        bytes.fetch_add(record.line.size(), std::memory_order_relaxed);
+    }
+};
+
+// One measured macro, `run` makes a single call
+struct Case {
+    std::string_view name;
+    void (*run)(uint64_t i);
+    void (*setup)() = nullptr;  //< Called once before the first measurement
+};
+
+[[gnu::noinline]] void runInfo(uint64_t i)       { ZINFO("request {} served in {} us", i, 42); }
+[[gnu::noinline]] void runFiltered(uint64_t i)   { ZINFO("filtered request {}", i); }
+[[gnu::noinline]] void runVar(uint64_t i)        { ZVAR(i); }
+[[gnu::noinline]] void runTrace(uint64_t)        { ZTRC; }
+[[gnu::noinline]] void runVerifyPass(uint64_t i) { ZVERIFY(i != UINT64_MAX, "index {} in range", i); }
+[[gnu::noinline]] void runVerifyFail(uint64_t i) { ZVERIFY(i == UINT64_MAX, "index {} in range", i); }
+[[gnu::noinline]] void runCaution(uint64_t)      { ZOPTIMIZE("hot path allocates"); }
+
+// Hit the filtered site once so it is registered, then disable it at runtime
+void setupFiltered()
+{
+    runFiltered(0);
+    zlog::forEachSite([](zlog::LogSite &site) {
+        if (site.FORMAT == "filtered request {}") site.enabled.store(false, std::memory_order_relaxed);
+    });
+}
+
+constexpr Case CASES[] = {
+    {"ZINFO"         , runInfo},
+    {"ZINFO filtered", runFiltered, setupFiltered},
+    {"ZVAR"          , runVar},
+    {"ZTRC"          , runTrace},
+    {"ZVERIFY pass"  , runVerifyPass},
+#ifdef ZLOG_T  // Failing checks abort outside test mode
+    {"ZVERIFY fail"  , runVerifyFail},
+#endif
+    {"ZCAUTION"      , runCaution},
+};
+
+struct Result {
+    std::string_view name;
+    uint32_t         threads;
+    uint64_t         calls;
+    double           ns_per_call;   //< Average time of one call on its thread
+    double           mcalls_sec;    //< Calls per second over all threads, in millions
+    double           allocs_call;
+    uint64_t         p50, p90, p99, p999, max;  //< Latency of single calls (ns)
+};
+
+// Smallest cost of reading the clock twice, subtracted from single call latencies
+uint64_t timerOverhead()
+{
+    uint64_t best = UINT64_MAX;
+
+    for (int i = 0; i < 10'000; ++i)
+    {
+        const auto start = Clock::now();
+        const auto end   = Clock::now();
+        best = std::min<uint64_t>(best, (end - start).count());
+    }
+
+    return best;
+}
+
+// Run `fn(thread_index)` on `threads` threads released together, returns the wall time
+template <typename Fn>
+Clock::duration runThreads(uint32_t threads, Fn &&fn)
+{
+    std::latch start {threads + 1};
+    std::vector<std::thread> workers {};
+    workers.reserve(threads);
+
+    for (uint32_t t = 0; t < threads; ++t)
+        workers.emplace_back([&, t] { start.arrive_and_wait(); fn(t); });
+
+    const auto begin = Clock::now();
+    start.arrive_and_wait();
+    for (std::thread &worker : workers) worker.join();
+    return Clock::now() - begin;
+}
+
+Result measure(const Case &bench, uint32_t threads, const Options &opt, uint64_t overhead)
+{
+    // Throughput pass: nothing but the calls between the clock reads
+    std::vector<uint64_t> elapsed (threads), allocs (threads);
+
+    const auto wall = runThreads(threads, [&](uint32_t t) {
+        const uint64_t allocs_before = s_allocs;
+        const auto start = Clock::now();
+
+        for (uint64_t i = 0; i < opt.iters; ++i) bench.run(i);
+
+        elapsed[t] = static_cast<uint64_t>((Clock::now() - start).count());
+        allocs[t]  = s_allocs - allocs_before;
+    });
+
+    // Latency pass: every call timed on its own
+    std::vector<uint64_t> samples (threads * opt.iters);
+
+    runThreads(threads, [&](uint32_t t) {
+        uint64_t *out = samples.data() + t * opt.iters;
+
+        for (uint64_t i = 0; i < opt.iters; ++i)
+        {
+            const auto start = Clock::now();
+            bench.run(i);
+            const auto ns = static_cast<uint64_t>((Clock::now() - start).count());
+            out[i] = ns > overhead ? ns - overhead : 0;
+        }
+    });
+
+    std::ranges::sort(samples);
+    const auto percentile = [&](double p) {
+        return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+    };
+
+    uint64_t total_ns = 0, total_allocs = 0;
+    for (uint32_t t = 0; t < threads; ++t) total_ns += elapsed[t], total_allocs += allocs[t];
+
+    const uint64_t calls = threads * opt.iters;
+    const double   wall_ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count());
+
+    return Result {
+        .name        = bench.name,
+        .threads     = threads,
+        .calls       = calls,
+        .ns_per_call = static_cast<double>(total_ns) / calls,
+        .mcalls_sec  = calls * 1e3 / wall_ns,
+        .allocs_call = static_cast<double>(total_allocs) / calls,
+        .p50         = percentile(0.50),
+        .p90         = percentile(0.90),
+        .p99         = percentile(0.99),
+        .p999        = percentile(0.999),
+        .max         = samples.back(),
+    };
+}
+
+void printHeader(Format format, uint64_t overhead)
+{
+    switch (format)
+    {
+    case Format::Table:
+        std::printf("%-16s %7s %10s %10s %9s %8s %8s %8s %8s %10s\n",
+                    "case", "threads", "ns/call", "Mcalls/s", "allocs", "p50", "p90", "p99", "p99.9", "max");
+        break;
+
+    case Format::Csv:
+        std::printf("case,threads,calls,ns_per_call,mcalls_per_sec,allocs_per_call,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+        break;
+
+    case Format::Json:
+        std::printf("{\"timer_overhead_ns\":%llu,\"results\":[\n", static_cast<unsigned long long>(overhead));
+        break;
+    }
+}
+
+void printResult(const Result &r, Format format, bool first)
+{
+    const auto u = [](uint64_t value) { return static_cast<unsigned long long>(value); };
+    const int  name_len = static_cast<int>(r.name.size());
+
+    switch (format)
+    {
+    case Format::Table:
+        std::printf("%-16.*s %7u %10.1f %10.2f %9.3f %8llu %8llu %8llu %8llu %10llu\n",
+                    name_len, r.name.data(), r.threads, r.ns_per_call, r.mcalls_sec, r.allocs_call,
+                    u(r.p50), u(r.p90), u(r.p99), u(r.p999), u(r.max));
+        break;
+
+    case Format::Csv:
+        std::printf("%.*s,%u,%llu,%.1f,%.3f,%.3f,%llu,%llu,%llu,%llu,%llu\n",
+                    name_len, r.name.data(), r.threads, u(r.calls), r.ns_per_call, r.mcalls_sec, r.allocs_call,
+                    u(r.p50), u(r.p90), u(r.p99), u(r.p999), u(r.max));
+        break;
+
+    case Format::Json:
+        std::printf("%s{\"case\":\"%.*s\",\"threads\":%u,\"calls\":%llu,\"ns_per_call\":%.1f,\"mcalls_per_sec\":%.3f,"
+                    "\"allocs_per_call\":%.3f,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}",
+                    first ? "" : ",\n", name_len, r.name.data(), r.threads, u(r.calls), r.ns_per_call, r.mcalls_sec,
+                    r.allocs_call, u(r.p50), u(r.p90), u(r.p99), u(r.p999), u(r.max));
+        break;
+    }
+
+    std::fflush(stdout);
+}
+
+bool parseThreads(std::string_view text, std::vector<uint32_t> &out)
+{
+    out.clear();
+
+    while (!text.empty())
+    {
+        const size_t comma = text.find(',');
+        const uint32_t count = static_cast<uint32_t>(std::strtoul(std::string{text.substr(0, comma)}.c_str(), nullptr, 10));
+        if (count == 0) return false;
+
+        out.push_back(count);
+        text = (comma == std::string_view::npos) ? std::string_view{} : text.substr(comma + 1);
+    }
+
+    return !out.empty();
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options opt {};
+    bool ok = true;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+
+        if      (arg.starts_with("--threads=")) ok = ok && parseThreads(arg.substr(10), opt.threads);
+        else if (arg.starts_with("--iters="))   opt.iters  = std::strtoull(argv[i] + 8, nullptr, 10);
+        else if (arg.starts_with("--filter="))  opt.filter = arg.substr(9);
+        else if (arg.starts_with("--file="))    opt.file   = argv[i] + 7;
+        else if (arg == "--format=table")       opt.format = Format::Table;
+        else if (arg == "--format=csv")         opt.format = Format::Csv;
+        else if (arg == "--format=json")        opt.format = Format::Json;
+        else                                    ok = false;
+    }
+
+    if (!ok || opt.iters == 0)
+    {
+        std::fprintf(stderr, "usage: bench [--threads=1,2,4,...] [--iters=N] [--filter=TEXT] [--file=PATH] [--format=table|csv|json]\n");
+        return 2;
+    }
+
+    const auto discard = std::make_shared<DiscardSink>();
+    zlog::clearSinks();
+    if (opt.file) zlog::addSink(std::make_shared<zlog::FileSink>(opt.file));
+    else zlog::addSink(discard);
+
+    const uint64_t overhead = timerOverhead();
+    printHeader(opt.format, overhead);
+
+    bool first = true;
+
+    for (const Case &bench : CASES)
+    {
+        if (bench.name.find(opt.filter) == std::string_view::npos) continue;
+
+        if (bench.setup) bench.setup();
+        for (uint64_t i = 0; i < 1'000; ++i) bench.run(i);  // Warm caches and thread-local buffers
+
+        for (const uint32_t threads : opt.threads)
+        {
+            printResult(measure(bench, threads, opt, overhead), opt.format, first);
+            first = false;
+        }
+    }
+
+    if (opt.format == Format::Json) std::printf("\n]}\n");
+
+    zlog::flush();
+    return 0;
+}
@@ -2,11 +2,14 @@ from io import TextIOWrapper
 from datetime import datetime
 from pathlib import Path
 import sys
+import re
 
 LIB_VER = 2
 LIB_SRC = Path("zlog")
 LIB_OUT = f"zlog_v{LIB_VER}.hpp"
 
+LOCAL_INCLUDE = re.compile(r'#include "\./(.+)"')
+
 includes: set[str] = set()
 
 
@@ -29,6 +32,7 @@ def write_from_file(f_out: TextIOWrapper, from_file: str) -> None:
     with open(from_file, 'r') as f_in:
         LINES = f_in.readlines()
         start_idx = 1
+        depth = 0  # Nesting of `#if` blocks, whose lines are kept as is
 
         while True:
             line = LINES[start_idx]
@@ -36,10 +40,18 @@ def write_from_file(f_out: TextIOWrapper, from_file: str) -> None:
             if line.strip().startswith("namespace"):
                 break
 
-            if line not in includes and '"' not in line:
+            if line.startswith("#if"):
+                depth += 1
+
+            if (depth > 0 or line not in includes) and '"' not in line:
                 f_out.write(line)
 
-            includes.add(line)
+            if line.startswith("#endif"):
+                depth -= 1
+
+            if depth == 0:
+                includes.add(line)
+
             start_idx += 1
 
         f_out.write("\n")
@@ -51,14 +63,37 @@ def write_from_file(f_out: TextIOWrapper, from_file: str) -> None:
         ])
 
 
+def ordered_sources() -> list[Path]:
+    # Headers sorted so each one follows the headers it includes
+    sources = {f_src.name: f_src for f_src in sorted(LIB_SRC.iterdir()) if f_src.is_file()}
+    ordered: list[Path] = []
+    visited: set[str] = set()
+
+    def visit(name: str) -> None:
+        if name in visited or name not in sources:
+            return
+
+        visited.add(name)
+
+        with open(sources[name], 'r') as f_in:
+            for match in LOCAL_INCLUDE.finditer(f_in.read()):
+                visit(match.group(1))
+
+        ordered.append(sources[name])
+
+    for name in sources:
+        visit(name)
+
+    return ordered
+
+
 def full_combine() -> None:
     with open(LIB_OUT, 'w') as f:
         f.write("#pragma once\n\n")
         write_desc(f)
 
-        for f_src in LIB_SRC.iterdir():
-            if f_src.is_file():
-                write_from_file(f, f_src)
+        for f_src in ordered_sources():
+            write_from_file(f, f_src)
 
 
 def part_combine() -> None:
@@ -67,9 +102,8 @@ def part_combine() -> None:
         write_desc(f)
 
         f.write("\n\n")
-        for file_name in LIB_SRC.iterdir():
-            if file_name.is_file():
-                f.write(f"#include \"{file_name}\" // IWYU pragma: keep\n")
+        for file_name in ordered_sources():
+            f.write(f"#include \"{file_name}\" // IWYU pragma: keep\n")
 
 
 if __name__ == "__main__":
@@ -1,4 +1,6 @@
+#include "zlog/lz.hpp"
 #include "zlog/log.hpp"
+#include "zlog/module.hpp"
 #include "zlog/test.hpp"
 #include "zlog/tools.hpp"
 #include "zlog/trace.hpp"
@@ -123,6 +125,124 @@ void run() {
 
 } // namespace demo_test
 
+namespace demo_cases {
+
+ZTEST_CASE(arithmetic) {
+    ZTEST(1 + 1 == 2);
+    ZEXPECT(2 * 3 == 6, "{}", "multiplication");
+}
+
+ZTEST_CASE(intentional_failure) {
+    ZINFO("Captured with the case: {}", "shown under its header");
+    ZTEST(2 + 2 == 5, "intentional fail: {} + {} != {}", 2, 2, 5);
+}
+
+// One block of `raw` read back, true if it is unchanged and nothing follows
+bool lzRoundTrip(std::string_view raw) {
+    std::string file;
+    zlog::lz::putBlock(file, raw);
+
+    std::string_view in = file;
+    std::string out;
+    return zlog::lz::getBlock(in, out) == zlog::lz::BlockStatus::Ok
+        && out == raw
+        && zlog::lz::getBlock(in, out) == zlog::lz::BlockStatus::End;
+}
+
+std::string lzRandom(size_t size) {
+    std::string out(size, '\0');
+    uint32_t state = 0x9E3779B9;
+
+    for (char &c : out) {
+        state = state * 1664525 + 1013904223;
+        c = static_cast<char>(state >> 24);
+    }
+
+    return out;
+}
+
+std::string lzRepetitive(size_t lines) {
+    std::string out;
+    for (size_t i = 0; i < lines; ++i) out += std::format("[INFO] : request {} served in {} ms\n", i, i % 7);
+    return out;
+}
+
+ZTEST_CASE(lz_round_trip) {
+    const std::string repetitive = lzRepetitive(2000);
+
+    std::string packed;
+    zlog::lz::compress(repetitive, packed);
+
+    std::string unpacked;
+    ZTEST(packed.size() < repetitive.size() / 4, "repetitive text compresses: {} -> {} bytes", repetitive.size(), packed.size());
+    ZTEST(zlog::lz::decompress(packed, repetitive.size(), unpacked) && unpacked == repetitive);
+
+    ZTEST(lzRoundTrip(repetitive));
+    ZTEST(lzRoundTrip(lzRandom(100'000)));
+    ZTEST(lzRoundTrip(std::string(70'000, 'z')));
+    ZTEST(lzRoundTrip("short"));
+    ZTEST(lzRoundTrip(""));
+}
+
+ZTEST_CASE(lz_truncated_tail) {
+    std::string file;
+    zlog::lz::putBlock(file, lzRepetitive(100));
+    const size_t first = file.size();
+    zlog::lz::putBlock(file, lzRepetitive(200));
+
+    std::string_view in = std::string_view{file}.substr(0, file.size() - 3);
+    std::string out;
+
+    ZTEST(zlog::lz::getBlock(in, out) == zlog::lz::BlockStatus::Ok && out == lzRepetitive(100));
+    ZTEST(zlog::lz::getBlock(in, out) == zlog::lz::BlockStatus::Truncated);
+    ZTEST(in.size() == file.size() - 3 - first, "a truncated block is left in the input");
+
+    in = std::string_view{file}.substr(0, first + zlog::lz::HEADER_SIZE - 1);
+    ZTEST(zlog::lz::getBlock(in, out) == zlog::lz::BlockStatus::Ok);
+    ZTEST(zlog::lz::getBlock(in, out) == zlog::lz::BlockStatus::Truncated, "cut inside the header");
+}
+
+ZTEST_CASE(lz_resync) {
+    std::string file;
+    zlog::lz::putBlock(file, lzRepetitive(100));
+    file.resize(file.size() / 2);  // A torn block, then blocks appended after a restart
+    const size_t torn = file.size();
+    zlog::lz::putBlock(file, lzRepetitive(50));
+
+    std::string_view in = file;
+    std::string out;
+    ZTEST(zlog::lz::getBlock(in, out) == zlog::lz::BlockStatus::Corrupt);
+
+    const size_t next = zlog::lz::findBlock(file, 1);
+    ZTEST(next == torn, "resumed at byte {} (expected {})", next, torn);
+
+    in = std::string_view{file}.substr(next);
+    ZTEST(zlog::lz::getBlock(in, out) == zlog::lz::BlockStatus::Ok && out == lzRepetitive(50));
+}
+
+ZTEST_CASE(module_wildcard) {
+    using zlog::LogLevel;
+    zlog::LogModule &net = zlog::internal::s_module<"net">;
+    zlog::LogModule &db  = zlog::internal::s_module<"db">;
+
+    zlog::setModuleLevels("net=debug,*=info");
+    ZTEST(net.allows(LogLevel::Debug), "'*' after an entry keeps it");
+    ZTEST(!db.allows(LogLevel::Debug) && db.allows(LogLevel::Info));
+
+    zlog::setModuleLevel("*", LogLevel::Error);
+    ZTEST(net.allows(LogLevel::Debug) && !db.allows(LogLevel::Warn));
+}
+
+void run() {
+    ZOUT << "=== TEST CASES SHOWCASE ===\n\n";
+
+    zlog::runTests();
+
+    ZOUT << "=== TEST CASES COMPLETE ===\n";
+}
+
+} // namespace demo_cases
+
 namespace demo_tools {
 
 void run() {
@@ -153,6 +273,7 @@ int main() {
     demo_log  ::run();
     demo_trace::run();
     demo_test ::run();
+    demo_cases::run();
     demo_tools::run();
 
     return 0;
@@ -0,0 +1,367 @@
+// Decodes a binary log written with `zlog::config::ENABLE_BINARY_LOG` into text
+//
+// usage: decode [--no-color] [--no-loc] [--time] <file.bin>
+
+#include "zlog/config.hpp"
+#include "zlog/binary.hpp"
+#include "zlog/sink.hpp"
+
+#include <ctime>
+#include <cstdio>
+#include <format>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+using zlog::binary::ArgType;
+
+struct Options {
+    bool color = true;
+    bool loc   = true;
+    bool time  = false;
+};
+
+struct Site {
+    zlog::LogLevel level;
+    bool           raw;
+    std::string    file;
+    uint32_t       line;
+    std::string    fmt;
+    std::string    module;  //< "[name]" tag, empty outside modules
+};
+
+struct Arg {
+    ArgType     type;
+    bool        b {};
+    char        c {};
+    int64_t     i {};
+    uint64_t    u {};
+    double      f {};
+    std::string s {};
+};
+
+struct Entry {
+    uint64_t    ns;
+    std::string text;
+};
+
+// Sequential reader over the raw file bytes
+class Reader {
+    std::string_view data;
+    size_t           pos {0};
+
+public:
+    explicit Reader(std::string_view data) : data{data} {}
+
+    [[nodiscard]] bool done() const noexcept { return pos >= data.size(); }
+
+    [[nodiscard]]
+    bool startsWith(std::string_view prefix) const noexcept
+    {
+        return data.substr(pos).starts_with(prefix);
+    }
+
+    void skip(size_t n) noexcept { pos = std::min(pos + n, data.size()); }
+
+    template <typename T>
+    bool get(T &out) noexcept
+    {
+        if (data.size() - pos < sizeof(T)) return false;
+        std::memcpy(&out, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    bool getBytes(size_t n, std::string &out)
+    {
+        if (data.size() - pos < n) return false;
+        out.assign(data.substr(pos, n));
+        pos += n;
+        return true;
+    }
+};
+
+// Format one argument with the replacement field spec (text after ':')
+std::string formatArg(const Arg &arg, std::string_view spec)
+{
+    const std::string pattern = spec.empty() ? "{}" : std::format("{{:{}}}", spec);
+
+    try
+    {
+        switch (arg.type)
+        {
+        case ArgType::Bool:    return std::vformat(pattern, std::make_format_args(arg.b));
+        case ArgType::Char:    return std::vformat(pattern, std::make_format_args(arg.c));
+        case ArgType::Int:     return std::vformat(pattern, std::make_format_args(arg.i));
+        case ArgType::Uint:    return std::vformat(pattern, std::make_format_args(arg.u));
+        case ArgType::Float:   return std::vformat(pattern, std::make_format_args(arg.f));
+        case ArgType::String:  return std::vformat(pattern, std::make_format_args(arg.s));
+        case ArgType::Pointer:
+        {
+            const void *ptr = reinterpret_cast<const void *>(static_cast<uintptr_t>(arg.u));
+            return std::vformat(pattern, std::make_format_args(ptr));
+        }
+        }
+    }
+    catch (const std::format_error &) {}
+
+    return "{?}";
+}
+
+// Substitute `args` into `fmt` (`{}`, `{N}`, `{:spec}`, `{N:spec}` and `{{`/`}}` escapes)
+std::string render(std::string_view fmt, const std::vector<Arg> &args)
+{
+    std::string out {};
+    size_t next_arg = 0;
+
+    for (size_t i = 0; i < fmt.size(); ++i)
+    {
+        const char ch = fmt[i];
+
+        if ((ch == '{' || ch == '}') && i + 1 < fmt.size() && fmt[i + 1] == ch)
+        {
+            out += ch;
+            ++i;
+            continue;
+        }
+
+        if (ch != '{')
+        {
+            out += ch;
+            continue;
+        }
+
+        const size_t close = fmt.find('}', i);
+        if (close == std::string_view::npos)
+        {
+            out.append(fmt.substr(i));
+            break;
+        }
+
+        std::string_view field = fmt.substr(i + 1, close - i - 1);
+        std::string_view spec {};
+
+        if (const size_t colon = field.find(':'); colon != std::string_view::npos)
+        {
+            spec  = field.substr(colon + 1);
+            field = field.substr(0, colon);
+        }
+
+        size_t idx = next_arg++;
+        if (!field.empty()) idx = static_cast<size_t>(std::strtoul(std::string{field}.c_str(), nullptr, 10));
+
+        out += (idx < args.size()) ? formatArg(args[idx], spec) : std::string{"{?}"};
+        i = close;
+    }
+
+    return out;
+}
+
+// "[HH:MM:SS.mmm]" local time of a unix timestamp in nanoseconds
+std::string formatTime(uint64_t ns)
+{
+    const std::time_t t = static_cast<std::time_t>(ns / 1'000'000'000);
+    std::tm tm_struct {};
+
+#ifdef _WIN32
+    localtime_s(&tm_struct, &t);
+#else
+    localtime_r(&t, &tm_struct);
+#endif
+
+    char buf[sizeof("HH:MM:SS")] {};
+    std::strftime(buf, sizeof(buf), "%H:%M:%S", &tm_struct);
+    return std::format("[{}.{:03}]", buf, (ns / 1'000'000) % 1000);
+}
+
+// Build the text line of one entry, matching the layout of the text logger
+std::string formatEntry(const Site &site, uint64_t ns, const std::vector<Arg> &args, const Options &opt)
+{
+    using namespace zlog;
+
+    std::string line {internal::colorReset()};
+
+    if (opt.time)
+        line += std::format("{}{}", ColorText{formatTime(ns), ANSI::EX_Black}, config::TAG_TAG);
+
+    line += std::format("{}{}", config::rendered::TAG_CTX[static_cast<int>(site.level)], config::TAG_TAG);
+
+    if (!site.module.empty())
+        line += std::format("{}{}", ColorText{site.module, config::MODULE_COLOR}, config::TAG_TAG);
+
+    if (opt.loc && !site.file.empty())
+    {
+        const std::string loc = std::format("[{}:{}]", site.file, site.line);
+        line += std::format("{}{}", ColorText{loc, ANSI::EX_Black}, config::TAG_TAG);
+    }
+
+    line += site.raw ? site.fmt : render(site.fmt, args);
+    line += '\n';
+
+    if (!opt.color)
+    {
+        std::string plain {};
+        internal::stripAnsi(line, plain);
+        return plain;
+    }
+
+    return line;
+}
+
+bool readArg(Reader &in, Arg &arg)
+{
+    if (!in.get(arg.type)) return false;
+
+    switch (arg.type)
+    {
+    case ArgType::Bool:
+    {
+        uint8_t v {};
+        if (!in.get(v)) return false;
+        arg.b = v != 0;
+        return true;
+    }
+    case ArgType::Char:    return in.get(arg.c);
+    case ArgType::Int:     return in.get(arg.i);
+    case ArgType::Uint:    return in.get(arg.u);
+    case ArgType::Float:   return in.get(arg.f);
+    case ArgType::Pointer: return in.get(arg.u);
+    case ArgType::String:
+    {
+        uint32_t len {};
+        return in.get(len) && in.getBytes(len, arg.s);
+    }
+    }
+
+    return false;
+}
+
+// Entries of one process run, in timestamp order (threads flush out of order)
+void printSession(std::vector<Entry> &entries)
+{
+    std::stable_sort(
+        entries.begin(), entries.end(),
+        [](const Entry &a, const Entry &b) { return a.ns < b.ns; }
+    );
+
+    for (const Entry &entry : entries) std::fwrite(entry.text.data(), 1, entry.text.size(), stdout);
+    entries.clear();
+}
+
+int decode(std::string_view data, const Options &opt)
+{
+    Reader in {data};
+    std::unordered_map<uint32_t, Site> sites {};
+    std::vector<Entry> entries {};
+
+    while (!in.done())
+    {
+        if (in.startsWith(zlog::binary::HEADER))
+        {
+            printSession(entries);
+            sites.clear();
+            in.skip(zlog::binary::HEADER.size());
+            continue;
+        }
+
+        char kind {};
+        if (!in.get(kind)) break;
+
+        if (kind == zlog::binary::SITE_RECORD)
+        {
+            uint32_t id {}, line {};
+            uint8_t level {}, flags {};
+            uint16_t file_len {};
+            uint32_t fmt_len {};
+            Site site {};
+
+            if (!in.get(id) || !in.get(level) || !in.get(flags) || !in.get(line)) break;
+            if (!in.get(file_len) || !in.getBytes(file_len, site.file)) break;
+            if (!in.get(fmt_len) || !in.getBytes(fmt_len, site.fmt)) break;
+
+            uint16_t module_len {};
+            if ((flags & zlog::binary::SITE_MODULE) && (!in.get(module_len) || !in.getBytes(module_len, site.module))) break;
+
+            site.level = static_cast<zlog::LogLevel>(std::min<uint8_t>(level, 5));
+            site.raw   = flags & zlog::binary::SITE_RAW;
+            site.line  = line;
+            sites[id]  = std::move(site);
+        }
+        else if (kind == zlog::binary::ENTRY_RECORD)
+        {
+            uint32_t id {};
+            uint64_t ns {};
+            uint8_t argc {};
+
+            if (!in.get(id) || !in.get(ns) || !in.get(argc)) break;
+
+            std::vector<Arg> args(argc);
+            bool ok = true;
+            for (Arg &arg : args) ok = ok && readArg(in, arg);
+            if (!ok) break;
+
+            const auto site = sites.find(id);
+            if (site == sites.end())
+            {
+                std::fprintf(stderr, "decode: entry references unknown site %u\n", id);
+                continue;
+            }
+
+            entries.push_back({ns, formatEntry(site->second, ns, args, opt)});
+        }
+        else
+        {
+            std::fprintf(stderr, "decode: corrupt record, stopping\n");
+            break;
+        }
+    }
+
+    printSession(entries);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options opt {};
+    opt.color = zlog::internal::colorEnabled();
+    opt.time  = zlog::config::ENABLE_TIMESTAMP;
+
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+
+        if      (arg == "--no-color") opt.color = false;
+        else if (arg == "--no-loc")   opt.loc   = false;
+        else if (arg == "--time")     opt.time  = true;
+        else                          path      = argv[i];
+    }
+
+    if (!path)
+    {
+        std::fprintf(stderr, "usage: decode [--no-color] [--no-loc] [--time] <file.bin>\n");
+        return 2;
+    }
+
+    std::ifstream file {path, std::ios::binary};
+    if (!file)
+    {
+        std::fprintf(stderr, "decode: cannot open '%s'\n", path);
+        return 1;
+    }
+
+    std::stringstream buffer {};
+    buffer << file.rdbuf();
+    return decode(buffer.str(), opt);
+}
@@ -0,0 +1,85 @@
+// Writes the text of compressed logs (`zlog::CompressedFileSink`, see `zlog/lz.hpp`) to stdout
+//
+// usage: lzcat <file.zlz>...
+//
+// A block cut short by a crash ends its file with a note on stderr. Damaged bytes are skipped
+// up to the next valid block (with a note), which fails once the file is read
+
+#include "zlog/lz.hpp"
+
+#include <cstdio>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+
+namespace {
+
+// Decompress every block of `path` to stdout, returns the exit status
+int cat(const char *path)
+{
+    std::ifstream file {path, std::ios::binary};
+    if (!file)
+    {
+        std::fprintf(stderr, "lzcat: cannot open '%s'\n", path);
+        return 1;
+    }
+
+    std::stringstream buffer {};
+    buffer << file.rdbuf();
+
+    const std::string data = buffer.str();
+    std::string_view in = data;
+    std::string raw {};
+    int status = 0;
+
+    while (true)
+    {
+        const size_t offset = data.size() - in.size();
+        const zlog::lz::BlockStatus block = zlog::lz::getBlock(in, raw);
+
+        if (block == zlog::lz::BlockStatus::Ok)
+        {
+            std::fwrite(raw.data(), 1, raw.size(), stdout);
+            continue;
+        }
+
+        if (block == zlog::lz::BlockStatus::End) return status;
+
+        // Cut short or damaged, resume at the next valid block if there is one
+        const size_t next = zlog::lz::findBlock(data, offset + 1);
+
+        if (next == std::string_view::npos)
+        {
+            if (block == zlog::lz::BlockStatus::Truncated)
+            {
+                std::fprintf(stderr, "lzcat: '%s' ends with an incomplete block at byte %zu\n", path, offset);
+                return status;
+            }
+
+            std::fprintf(stderr, "lzcat: '%s' has a corrupt block at byte %zu\n", path, offset);
+            return 1;
+        }
+
+        std::fprintf(stderr, "lzcat: '%s' skipped %zu damaged bytes at byte %zu\n", path, next - offset, offset);
+        in = std::string_view{data}.substr(next);
+        status = 1;
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: lzcat <file.zlz>...\n");
+        return 2;
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc; ++i) status |= cat(argv[i]);
+
+    std::fflush(stdout);
+    return status;
+}
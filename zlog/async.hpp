@@ -0,0 +1,326 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./prostring.hpp"
+#include "./sink.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <condition_variable>
+
+namespace zlog {
+
+namespace internal {
+
+// Bounded lock-free multi-producer multi-consumer queue (Vyukov)
+template <typename T, size_t CAPACITY>
+class RingQueue final {
+    static_assert(
+        CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0,
+        "RingQueue capacity must be a power of two"
+    );
+
+    static constexpr size_t MASK = CAPACITY - 1;
+
+    struct alignas(64) Cell {
+        std::atomic<size_t> seq;   //< Sequence number guarding `data`
+        T                   data;  //< Stored element
+    };
+
+    std::unique_ptr<Cell[]> cells;  //< Heap allocated, capacity may be large
+
+    alignas(64) std::atomic<size_t> head {0};  //< Next position to pop
+    alignas(64) std::atomic<size_t> tail {0};  //< Next position to push
+
+public:
+    RingQueue() : cells{std::make_unique<Cell[]>(CAPACITY)}
+    {
+        for (size_t i = 0; i < CAPACITY; ++i)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    // Moves `value` into the queue, false if full (`value` is left untouched)
+    [[nodiscard]]
+    bool tryPush(T &value) noexcept
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            Cell &cell = cells[pos & MASK];
+            const size_t seq = cell.seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+            if (diff == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.data = std::move(value);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) return false;
+            else pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Moves the oldest element into `out`, false if empty
+    [[nodiscard]]
+    bool tryPop(T &out) noexcept
+    {
+        size_t pos = head.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            Cell &cell = cells[pos & MASK];
+            const size_t seq = cell.seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+            if (diff == 0)
+            {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    out = std::move(cell.data);
+                    cell.seq.store(pos + CAPACITY, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) return false;
+            else pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Approximate number of queued elements
+    [[nodiscard]]
+    size_t size() const noexcept
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        const size_t h = head.load(std::memory_order_relaxed);
+        return t > h ? t - h : 0;
+    }
+
+    // Positions handed to pushes so far (a push in progress already holds its position)
+    [[nodiscard]]
+    size_t pushPosition() const noexcept { return tail.load(std::memory_order_acquire); }
+
+    // Positions claimed by pops so far
+    [[nodiscard]]
+    size_t popPosition() const noexcept { return head.load(std::memory_order_acquire); }
+};
+
+// Rendered log line waiting for the writer thread
+struct AsyncRecord {
+    LogLevel            level {LogLevel::Info};  //< Selects the output stream
+    internal::ProString line  {};                //< Fully rendered line, inline unless oversized
+};
+
+// Background writer draining a lock-free queue of rendered log lines
+class AsyncLogger final {
+    static constexpr size_t BATCH_SIZE = 256;  //< Max records per write batch
+
+    RingQueue<AsyncRecord, config::ASYNC_QUEUE_SIZE> queue {};
+
+    std::atomic<size_t>   written {0};  //< Queue positions below this are written or dropped
+    std::atomic<uint64_t> dropped {0};  //< Records lost to the overflow policy
+
+    std::atomic<bool>       running  {true};
+    std::atomic<bool>       sleeping {false};
+    std::mutex              wake_mutex {};
+    std::mutex              drain_mutex {};  //< Serializes drains once the writer is stopped
+    std::condition_variable wake_cv    {};
+    std::thread             writer     {};  //< Started last, after every other member
+
+    AsyncLogger() : writer{[this] { _run(); }} {}
+
+    // Wake the writer if it is waiting for records
+    void _wake() noexcept
+    {
+        if (sleeping.load(std::memory_order_acquire)) wake_cv.notify_one();
+    }
+
+    // Hand records to the sinks in order
+    static void _write(const AsyncRecord *records, size_t count, std::vector<LogRecord> &views)
+    {
+        views.clear();
+        for (size_t i = 0; i < count; ++i)
+            views.push_back(LogRecord{records[i].level, records[i].line.view()});
+
+        SinkRegistry::instance().dispatchBatch(views.data(), views.size());
+    }
+
+    // Pop up to `BATCH_SIZE` records into `batch` and write them, false if there were none
+    bool _drainBatch(std::vector<AsyncRecord> &batch, std::vector<LogRecord> &views)
+    {
+        AsyncRecord record {};
+        while (batch.size() < BATCH_SIZE && queue.tryPop(record))
+            batch.push_back(std::move(record));
+
+        const bool any = !batch.empty();
+
+        if (any)
+        {
+            _write(batch.data(), batch.size(), views);
+            batch.clear();
+        }
+
+        // Pops that write are the writer's (or, once it is stopped, `_drainStopped`), every other
+        // claimed position was dropped
+        written.store(queue.popPosition(), std::memory_order_release);
+        return any;
+    }
+
+    // Write what is left in the queue on the calling thread, once the writer is stopped
+    void _drainStopped() noexcept
+    {
+        std::scoped_lock<std::mutex> lock {drain_mutex};
+
+        std::vector<AsyncRecord> batch {};
+        std::vector<LogRecord>   views {};
+        while (_drainBatch(batch, views)) {}
+    }
+
+    // Writer thread loop, exits once stopped and drained
+    void _run()
+    {
+        std::vector<AsyncRecord> batch {};
+        std::vector<LogRecord>   views {};
+        batch.reserve(BATCH_SIZE);
+        views.reserve(BATCH_SIZE);
+
+        while (true)
+        {
+            if constexpr (config::ENABLE_LOG_STATS)
+                LogStatsRegistry::instance().queue(queue.size(), dropped.load(std::memory_order_relaxed));
+
+            if (_drainBatch(batch, views)) continue;
+            if (!running.load(std::memory_order_acquire)) break;
+
+            std::unique_lock<std::mutex> lock {wake_mutex};
+            sleeping.store(true, std::memory_order_release);
+
+            // Timed wait bounds the delay of a wakeup lost to a racing push
+            if (queue.size() == 0 && running.load(std::memory_order_acquire))
+                wake_cv.wait_for(lock, std::chrono::milliseconds{10});
+
+            sleeping.store(false, std::memory_order_release);
+        }
+    }
+
+public:
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger &operator=(const AsyncLogger&) = delete;
+
+    // Process-wide logger, never destroyed so it outlives static destruction
+    [[nodiscard]]
+    static AsyncLogger &instance() noexcept
+    {
+        static AsyncLogger *s_logger = [] {
+            AsyncLogger *logger = new AsyncLogger{};
+            std::atexit([] { instance().shutdown(); });
+            return logger;
+        }();
+
+        return *s_logger;
+    }
+
+    // Queue a rendered line, applying `config::ASYNC_OVERFLOW` when full
+    void push(LogLevel level, ProString &&line) noexcept
+    {
+        AsyncRecord record {level, std::move(line)};
+
+        if (!running.load(std::memory_order_acquire))
+        {
+            std::vector<LogRecord> views {};
+            _write(&record, 1, views); // Writer is gone, write synchronously
+            return;
+        }
+
+        while (!queue.tryPush(record))
+        {
+            if constexpr (config::ASYNC_OVERFLOW == OverflowPolicy::DropNewest)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else if constexpr (config::ASYNC_OVERFLOW == OverflowPolicy::DropOldest)
+            {
+                AsyncRecord oldest {};
+                if (queue.tryPop(oldest)) dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                _wake();
+                std::this_thread::yield();
+            }
+        }
+
+        // Sampled here rather than by the writer, which misses bursts drained within one batch
+        if constexpr (config::ENABLE_LOG_STATS) LogStatsRegistry::instance().queuePeak(queue.size());
+
+        // `shutdown()` may have drained the queue between the check above and the push,
+        // write the queue from here (pairs with the fence in `shutdown()`)
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!running.load(std::memory_order_relaxed))
+        {
+            _drainStopped();
+            return;
+        }
+
+        _wake();
+    }
+
+    // Block until every record queued before this call has reached the sinks, then flush them
+    // (waits for queue positions, not counts, so records still being pushed by other threads
+    // cannot stand in for the caller's own)
+    void flush() noexcept
+    {
+        const size_t target = queue.pushPosition();
+
+        while (written.load(std::memory_order_acquire) < target)
+        {
+            if (!running.load(std::memory_order_acquire)) break;
+            _wake();
+            std::this_thread::yield();
+        }
+
+        SinkRegistry::instance().flush();
+    }
+
+    // Stop the writer thread after draining the queue
+    void shutdown() noexcept
+    {
+        if (!running.exchange(false, std::memory_order_seq_cst)) return;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        {
+            std::scoped_lock<std::mutex> lock {wake_mutex};
+            wake_cv.notify_one();
+        }
+
+        if (writer.joinable()) writer.join();
+
+        // Records pushed while the writer was exiting
+        _drainStopped();
+    }
+
+    // Records lost to the overflow policy
+    [[nodiscard]]
+    uint64_t droppedCount() const noexcept { return dropped.load(std::memory_order_relaxed); }
+
+    // Approximate number of records waiting to be written
+    [[nodiscard]]
+    size_t queueDepth() const noexcept { return queue.size(); }
+};
+
+} // namespace internal
+
+} // namespace zlog
@@ -0,0 +1,317 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./site.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <format>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#include <concepts>
+#include <string_view>
+#include <type_traits>
+
+namespace zlog {
+
+namespace binary {
+
+// Layout of a binary log (native byte order):
+//
+//   file    := { HEADER { site | entry } }           (one HEADER per process run)
+//   site    := 'S' u32:id u8:level u8:flags u32:line u16:file_len file u32:fmt_len fmt
+//              [ u16:module_len module ]              (if flags has SITE_MODULE)
+//   entry   := 'E' u32:id u64:unix_ns u8:argc { arg }
+//   arg     := u8:ArgType payload
+//
+// Site records always precede the entries that reference them.
+
+static constexpr std::string_view HEADER = "ZLOGBIN\x01";
+
+static constexpr char SITE_RECORD  = 'S';
+static constexpr char ENTRY_RECORD = 'E';
+
+// Site flags
+static constexpr uint8_t SITE_RAW    = 1;  //< Format string is printed verbatim
+static constexpr uint8_t SITE_MODULE = 2;  //< Logged through a module, its "[name]" tag follows
+
+// Encoded argument types
+enum class ArgType : uint8_t {
+    Bool,     //< u8
+    Char,     //< u8
+    Int,      //< i64
+    Uint,     //< u64
+    Float,    //< f64
+    String,   //< u32 length + bytes (also used for types formatted on the caller)
+    Pointer,  //< u64
+};
+
+} // namespace binary
+
+namespace internal {
+
+// Appends the raw bytes of `value` to `out`
+template <typename T>
+inline void putRaw(std::string &out, const T &value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+// Appends a length prefixed string to `out`
+inline void putString(std::string &out, std::string_view text)
+{
+    putRaw(out, static_cast<uint32_t>(text.size()));
+    out.append(text);
+}
+
+// Appends one tagged argument to `out`
+template <typename T>
+inline void putArg(std::string &out, const T &value)
+{
+    using binary::ArgType;
+    using V = std::remove_cvref_t<T>;
+
+    if constexpr (std::same_as<V, bool>)
+    {
+        putRaw(out, ArgType::Bool);
+        putRaw(out, static_cast<uint8_t>(value));
+    }
+    else if constexpr (std::same_as<V, char>)
+    {
+        putRaw(out, ArgType::Char);
+        putRaw(out, value);
+    }
+    else if constexpr (std::signed_integral<V>)
+    {
+        putRaw(out, ArgType::Int);
+        putRaw(out, static_cast<int64_t>(value));
+    }
+    else if constexpr (std::unsigned_integral<V>)
+    {
+        putRaw(out, ArgType::Uint);
+        putRaw(out, static_cast<uint64_t>(value));
+    }
+    else if constexpr (std::floating_point<V>)
+    {
+        putRaw(out, ArgType::Float);
+        putRaw(out, static_cast<double>(value));
+    }
+    else if constexpr (std::convertible_to<const V&, std::string_view>)
+    {
+        putRaw(out, ArgType::String);
+        putString(out, std::string_view{value});
+    }
+    else if constexpr (std::is_pointer_v<V> || std::same_as<V, std::nullptr_t>)
+    {
+        putRaw(out, ArgType::Pointer);
+        putRaw(out, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+    }
+    else // Anything else is formatted on the caller, straight into the buffer
+    {
+        putRaw(out, ArgType::String);
+
+        const size_t len_pos = out.size();
+        putRaw(out, uint32_t{0});
+        std::format_to(std::back_inserter(out), "{}", value);
+
+        const auto len = static_cast<uint32_t>(out.size() - len_pos - sizeof(uint32_t));
+        std::memcpy(out.data() + len_pos, &len, sizeof(len));
+    }
+}
+
+// Binary log file shared by every thread
+class BinaryLogger final {
+    static constexpr size_t FLUSH_BYTES = 64 * 1024;  //< Per-thread buffer flush threshold
+
+    // Per-thread encoded entries
+    struct ThreadBytes {
+        std::mutex  mutex {};  //< Only contended by `flushAll()`
+        std::string bytes {};
+
+        ThreadBytes()
+        {
+            bytes.reserve(FLUSH_BYTES + 1024);
+            instance()._attach(this);
+        }
+
+        ~ThreadBytes()
+        {
+            instance()._detach(this);
+        }
+    };
+
+    std::mutex                 mutex    {};  //< Guards the file, sites and registry
+    std::FILE                 *file     {nullptr};
+    uint32_t                   next_id  {1};
+    std::vector<ThreadBytes *> threads  {};
+
+    inline static thread_local bool s_destroyed = false;
+
+    BinaryLogger()
+    {
+        file = std::fopen(config::BINARY_LOG_PATH, "ab");
+        if (file) std::fwrite(binary::HEADER.data(), 1, binary::HEADER.size(), file);
+    }
+
+    // Write and clear a thread's bytes (caller holds `mutex`)
+    void _drain(ThreadBytes &local) noexcept
+    {
+        std::scoped_lock<std::mutex> lock {local.mutex};
+        if (file && !local.bytes.empty()) std::fwrite(local.bytes.data(), 1, local.bytes.size(), file);
+        local.bytes.clear();
+    }
+
+    void _attach(ThreadBytes *local)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        threads.push_back(local);
+    }
+
+    void _detach(ThreadBytes *local) noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        _drain(*local);
+        std::erase(threads, local);
+        s_destroyed = true;
+    }
+
+    // Calling thread's bytes, nullptr once destroyed at thread exit
+    [[nodiscard]]
+    static ThreadBytes *_local() noexcept
+    {
+        if (s_destroyed) return nullptr;
+
+        thread_local ThreadBytes s_bytes {};
+        return &s_bytes;
+    }
+
+    // Assign an id to `site` and write its site record
+    uint32_t _register(LogSite &site, std::string_view module, std::string_view fmt, bool raw) noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        if (const uint32_t id = site.binary_id.load(std::memory_order_relaxed)) return id;
+
+        const uint32_t id = next_id++;
+        const std::string_view file_name = site.LOC.isEmpty() ? "" : site.LOC.FILE;
+
+        std::string record {};
+        putRaw(record, binary::SITE_RECORD);
+        putRaw(record, id);
+        putRaw(record, static_cast<uint8_t>(site.LEVEL));
+        putRaw(record, static_cast<uint8_t>((raw ? binary::SITE_RAW : 0) | (module.empty() ? 0 : binary::SITE_MODULE)));
+        putRaw(record, site.LOC.LINE);
+        putRaw(record, static_cast<uint16_t>(file_name.size()));
+        record.append(file_name);
+        putString(record, fmt);
+
+        if (!module.empty())
+        {
+            putRaw(record, static_cast<uint16_t>(module.size()));
+            record.append(module);
+        }
+
+        if (file) std::fwrite(record.data(), 1, record.size(), file);
+
+        site.binary_id.store(id, std::memory_order_release);
+        return id;
+    }
+
+public:
+    BinaryLogger(const BinaryLogger&) = delete;
+    BinaryLogger &operator=(const BinaryLogger&) = delete;
+
+    // Process-wide binary log, never destroyed so it outlives static destruction
+    [[nodiscard]]
+    static BinaryLogger &instance() noexcept
+    {
+        static BinaryLogger *s_logger = new BinaryLogger{};
+        return *s_logger;
+    }
+
+    // Encode one entry for `site` of `module` (empty for none) with format `fmt` (verbatim if `raw`)
+    template <typename... Args>
+    void log(LogSite &site, std::string_view module, std::string_view fmt, bool raw, const Args&... args)
+    {
+        uint32_t id = site.binary_id.load(std::memory_order_acquire);
+        if (!id) id = _register(site, module, fmt, raw);
+
+        const auto now = std::chrono::system_clock::now().time_since_epoch();
+        const auto ns  = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+
+        ThreadBytes *local = _local();
+        if (!local) return;
+
+        {
+            std::scoped_lock<std::mutex> lock {local->mutex};
+            std::string &out = local->bytes;
+
+            putRaw(out, binary::ENTRY_RECORD);
+            putRaw(out, id);
+            putRaw(out, static_cast<uint64_t>(ns));
+            putRaw(out, static_cast<uint8_t>(sizeof...(Args)));
+            (putArg(out, args), ...);
+
+            if (out.size() < FLUSH_BYTES && site.LEVEL != LogLevel::Fatal) return;
+        }
+
+        std::scoped_lock<std::mutex> lock {mutex};
+        _drain(*local);
+        if (file && site.LEVEL == LogLevel::Fatal) std::fflush(file);
+    }
+
+    // Write every thread's pending entries to the file
+    void flushAll() noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        for (ThreadBytes *local : threads) _drain(*local);
+        if (file) std::fflush(file);
+    }
+};
+
+// Record a macro call of `module` (its "[name]" tag, empty for none): the first argument is
+// the format string, or the message if alone
+template <typename First, typename... Args>
+inline void binaryLogModule(LogSite &site, std::string_view module, const First &first, const Args&... args)
+{
+    BinaryLogger &logger = BinaryLogger::instance();
+
+    if constexpr (sizeof...(Args) > 0)
+        logger.log(site, module, std::string_view{first}, false, args...);
+    else if constexpr (std::is_array_v<First>)
+        logger.log(site, module, std::string_view{first}, true); // Literal, stored once in the site
+    else
+        logger.log(site, module, "{}", false, std::string_view{first});
+}
+
+// Record a macro call: the first argument is the format string, or the message if alone
+template <typename First, typename... Args>
+inline void binaryLog(LogSite &site, const First &first, const Args&... args)
+{
+    binaryLogModule(site, {}, first, args...);
+}
+
+// Record an already formatted message without a source location
+inline void binaryLogText(LogLevel lvl, std::string_view text)
+{
+    static constinit LogSite s_sites[] = {
+        {LogLevel::Trace, {}, "{}", ""}, {LogLevel::Debug, {}, "{}", ""},
+        {LogLevel::Info , {}, "{}", ""}, {LogLevel::Warn , {}, "{}", ""},
+        {LogLevel::Error, {}, "{}", ""}, {LogLevel::Fatal, {}, "{}", ""},
+    };
+
+    BinaryLogger::instance().log(s_sites[static_cast<int>(lvl)], {}, "{}", false, text);
+}
+
+} // namespace internal
+
+} // namespace zlog
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./os.hpp"
+#include "./stats.hpp"
+
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <string_view>
+
+namespace zlog {
+
+namespace internal {
+
+// Serializes descriptor writes so batches from different threads never interleave
+[[nodiscard]]
+inline std::mutex &logMutex() noexcept
+{
+    static std::mutex s_log_mutex {};
+    return s_log_mutex;
+}
+
+// Locks `logMutex()`, timing the wait when it is contended (with `config::ENABLE_LOG_STATS`)
+[[nodiscard]]
+inline std::unique_lock<std::mutex> lockLog() noexcept
+{
+    if constexpr (!config::ENABLE_LOG_STATS) return std::unique_lock<std::mutex>{logMutex()};
+    else
+    {
+        std::unique_lock<std::mutex> lock {logMutex(), std::try_to_lock};
+        if (lock.owns_lock())
+        {
+            LogStatsRegistry::instance().time(LogTiming::LockWait, 0);
+            return lock;
+        }
+
+        const uint64_t start = _statsNow();
+        lock.lock();
+        LogStatsRegistry::instance().time(LogTiming::LockWait, _statsNow() - start);
+        return lock;
+    }
+}
+
+// Per-thread pending output, flushed with one write per descriptor
+class ThreadBuffer final {
+    using Clock = std::chrono::steady_clock;
+
+    // Pending lines for one descriptor
+    struct Pending {
+        std::string       text  {};  //< Contiguous rendered lines
+        size_t            lines {0};
+        Clock::time_point since {};  //< Time the oldest pending line was added
+    };
+
+    std::mutex mutex {};       //< Only contended by `flushAll()`
+    Pending    out   {};       //< stdout lines
+    Pending    err   {};       //< stderr lines
+
+    inline static thread_local bool s_destroyed = false;
+
+    // All live thread buffers, for process-wide flushes
+    [[nodiscard]]
+    static std::vector<ThreadBuffer *> &_registry() noexcept
+    {
+        static std::vector<ThreadBuffer *> s_buffers {};
+        return s_buffers;
+    }
+
+    [[nodiscard]]
+    static std::mutex &_registryMutex() noexcept
+    {
+        static std::mutex s_registry_mutex {};
+        return s_registry_mutex;
+    }
+
+    // Write and clear pending lines (caller holds `mutex`)
+    static void _flush(int fd, Pending &pending) noexcept
+    {
+        if (pending.text.empty()) return;
+
+        {
+            const std::unique_lock<std::mutex> lock = lockLog();
+            writeFd(fd, pending.text);
+        }
+
+        pending.text.clear();
+        pending.lines = 0;
+    }
+
+    // True if a configured threshold is reached
+    [[nodiscard]]
+    static bool _isDue(const Pending &pending) noexcept
+    {
+        if (pending.lines >= config::BUFFER_FLUSH_LINES) return true;
+        if (pending.text.size() >= config::BUFFER_FLUSH_BYTES) return true;
+
+        return Clock::now() - pending.since
+            >= std::chrono::milliseconds{config::BUFFER_FLUSH_MS};
+    }
+
+    ThreadBuffer()
+    {
+        out.text.reserve(std::min<size_t>(config::BUFFER_FLUSH_BYTES, 4096));
+        err.text.reserve(std::min<size_t>(config::BUFFER_FLUSH_BYTES, 4096));
+
+        std::scoped_lock<std::mutex> lock {_registryMutex()};
+        _registry().push_back(this);
+    }
+
+public:
+    ThreadBuffer(const ThreadBuffer&) = delete;
+    ThreadBuffer &operator=(const ThreadBuffer&) = delete;
+
+    ~ThreadBuffer()
+    {
+        flush();
+        s_destroyed = true;
+
+        std::scoped_lock<std::mutex> lock {_registryMutex()};
+        std::erase(_registry(), this);
+    }
+
+    // Calling thread's buffer, nullptr once it has been destroyed at thread exit
+    [[nodiscard]]
+    static ThreadBuffer *local() noexcept
+    {
+        if (s_destroyed) return nullptr;
+
+        thread_local ThreadBuffer s_buffer {};
+        return &s_buffer;
+    }
+
+    // Queue one rendered line and flush if a threshold is reached
+    void append(int fd, std::string_view line)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        Pending &pending = (fd == FD_OUT) ? out : err;
+
+        // Unbuffered: write the caller's line without copying it
+        if (config::BUFFER_FLUSH_LINES <= 1 && pending.text.empty())
+        {
+            const std::unique_lock<std::mutex> write_lock = lockLog();
+            writeFd(fd, line);
+            return;
+        }
+
+        if (pending.lines == 0)
+        {
+            if constexpr (config::BUFFER_FLUSH_LINES > 1) pending.since = Clock::now();
+        }
+
+        pending.text += line;
+        ++pending.lines;
+
+        if (_isDue(pending)) _flush(fd, pending);
+    }
+
+    // Write this thread's pending lines
+    void flush() noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        _flush(FD_OUT, out);
+        _flush(FD_ERR, err);
+    }
+
+    // Write every thread's pending lines
+    static void flushAll() noexcept
+    {
+        std::scoped_lock<std::mutex> lock {_registryMutex()};
+        for (ThreadBuffer *buffer : _registry()) buffer->flush();
+    }
+};
+
+} // namespace internal
+
+} // namespace zlog
@@ -1,8 +1,26 @@
 #pragma once
 
+#include <array>
 #include <format>
+#include <cstdint>
+#include <cstdlib>
 #include <ostream>
+#include <iterator>
+#include <algorithm>
 #include <string_view>
+#include <type_traits>
+#include <source_location>
+
+// Platform headers (kept in this one file so `build.py` can merge them)
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#endif
 
 namespace zlog {
 
@@ -16,6 +34,30 @@ enum class LogLevel : uint8_t {
     Fatal,  //< Fatal errors causing program termination
 };
 
+// Behaviour of the asynchronous queue when it is full
+enum class OverflowPolicy : uint8_t {
+    Block,       //< Wait for the writer thread to free a slot
+    DropNewest,  //< Discard the record being logged
+    DropOldest,  //< Discard the oldest queued record
+};
+
+// Layout of log timestamps
+enum class TimestampFormat : uint8_t {
+    Clock,        //< [HH:MM:SS]
+    ClockMillis,  //< [HH:MM:SS.mmm]
+    ClockMicros,  //< [HH:MM:SS.uuuuuu]
+    Iso8601,      //< [YYYY-MM-DDTHH:MM:SS.uuuuuu+hhmm]
+    EpochNanos,   //< [nanoseconds since the unix epoch]
+    Monotonic,    //< [+seconds.uuuuuu since process start]
+};
+
+// Encoding of structured (`ZINFO_KV`) lines
+enum class KvEncoding : uint8_t {
+    Text,    //< [INFO] : message key=value (colored like other lines)
+    Logfmt,  //< level=info msg=message key=value
+    Json,    //< {"level":"info","msg":"message","key":value}
+};
+
 // ANSI escape codes for terminal styling
 enum class ANSI : uint8_t {
 // =============== TEXT ATTRIBUTES ===============
@@ -72,16 +114,128 @@ struct ColorText {
     const ANSI             COLOR;  //< ANSI color code for the text
 };
 
+// `ColorText` rendered at compile time, holding both the colored and the plain bytes
+struct RenderedText {
+    char    data[48]  {};  //< "\033[<code>m" TEXT "\033[0m"
+    uint8_t size      {0};
+    uint8_t text_pos  {0};  //< Offset of TEXT in `data`
+    uint8_t text_size {0};
+
+    [[nodiscard]]
+    constexpr std::string_view colored() const noexcept { return {data, size}; }
+
+    [[nodiscard]]
+    constexpr std::string_view plain() const noexcept { return {data + text_pos, text_size}; }
+};
+
+// Render `ct` with its escape codes at compile time
+[[nodiscard]]
+consteval RenderedText prerender(const ColorText &ct)
+{
+    RenderedText out {};
+    auto put = [&](std::string_view text) {
+        for (char ch : text) out.data[out.size++] = ch;
+    };
+
+    char code[4] {};
+    int code_len = 0;
+    for (int value = static_cast<int>(ct.COLOR); code_len == 0 || value > 0; value /= 10)
+        code[code_len++] = static_cast<char>('0' + value % 10);
+    std::reverse(code, code + code_len);
+
+    put("\033[");
+    put(std::string_view{code, static_cast<size_t>(code_len)});
+    put("m");
+
+    out.text_pos  = out.size;
+    out.text_size = static_cast<uint8_t>(ct.TEXT.size());
+
+    put(ct.TEXT);
+    put("\033[0m");
+    return out;
+}
+
 namespace config {
 
 // === MODIFY THESE VALUES ===
 
 // General flags
 static constexpr bool DISABLE_LOGGING   = false;  // Completely disable logging
-static constexpr bool ENABLE_TIMESTAMP  = false;  // Add [HH:MM:SS] to logs
+static constexpr bool ENABLE_TIMESTAMP  = false;  // Add a timestamp to logs
 static constexpr bool ENABLE_COLOR      = true;   // Enable ANSI colors
+static constexpr bool DETECT_TTY        = true;   // Disable colors when output is not a terminal
 static constexpr bool ENABLE_TRACE_DULL = true;   // Make trace messages gray
 
+// Timestamp layout (when `ENABLE_TIMESTAMP` is set)
+static constexpr TimestampFormat TIMESTAMP_FORMAT = TimestampFormat::Clock;
+
+// Asynchronous logging (records are written by a background thread)
+static constexpr bool           ENABLE_ASYNC     = false;
+static constexpr size_t         ASYNC_QUEUE_SIZE = 8192;  // Power of two
+static constexpr OverflowPolicy ASYNC_OVERFLOW   = OverflowPolicy::Block;
+
+// Binary logging (macros store a call-site id and raw arguments, see `tools/decode.cpp`)
+static constexpr bool        ENABLE_BINARY_LOG = false;
+static constexpr const char *BINARY_LOG_PATH   = "zlog.bin";
+
+// Scope timeline (`ZTRC` scopes recorded as Chrome Trace / Perfetto JSON, see `zlog/timeline.hpp`)
+static constexpr bool        ENABLE_TIMELINE   = false;
+static constexpr const char *TIMELINE_PATH     = "zlog_trace.json";  // Written at exit
+static constexpr size_t      TIMELINE_CAPACITY = 1 << 20;            // Max events kept per thread
+
+// Scope profiler (per call site count, total/min/max and latency percentiles, see `zlog/profiler.hpp`)
+static constexpr bool   ENABLE_PROFILER         = false;
+static constexpr bool   PROFILER_REPORT_AT_EXIT = true;  // Print the report to stderr at exit
+static constexpr size_t PROFILER_MAX_SITES      = 1024;  // Further call sites are not profiled
+
+// Logger self-statistics (lines and bytes per level, time spent formatting, rendering, dispatching
+// and waiting for the output mutex, queue depth and drops, see `zlog/stats.hpp`)
+static constexpr bool     ENABLE_LOG_STATS    = false;
+static constexpr bool     LOG_STATS_AT_EXIT   = true;  // Print the report to stderr at exit
+static constexpr uint32_t LOG_STATS_DUMP_MS   = 0;     // Print the report to stderr this often (0 = never)
+
+// Per-thread output buffering (each batch is a single write to the descriptor)
+static constexpr size_t   BUFFER_FLUSH_BYTES = 64 * 1024;  // Flush once this many bytes are pending
+static constexpr size_t   BUFFER_FLUSH_LINES = 1;          // Flush once this many lines are pending
+static constexpr uint32_t BUFFER_FLUSH_MS    = 100;        // Flush lines pending longer than this
+
+// Per call site rate limiting and repeat collapsing (`ZERR_RATE`, `ZERR_EVERY` override the limit)
+static constexpr uint32_t RATE_LIMIT_PER_SEC  = 0;      // Lines per second of each log site (0 = unlimited)
+static constexpr uint32_t RATE_LIMIT_BURST    = 100;    // Lines a site may emit at once before being limited
+static constexpr bool     COLLAPSE_REPEATS    = false;  // Identical lines of a site become "last message repeated N times"
+static constexpr uint32_t COLLAPSE_WINDOW_MS  = 10000;  // Repeats older than this are logged again
+
+// Flight recorder (last records of every thread, dumped on `ZFATAL`, `ZPANIC`, `critical()`
+// and crash signals, see `zlog/flight.hpp`)
+static constexpr bool        ENABLE_FLIGHT_RECORDER = false;
+static constexpr size_t      FLIGHT_RECORDS         = 256;    // Records kept per thread
+static constexpr size_t      FLIGHT_RECORD_BYTES    = 240;    // Longer messages are truncated
+static constexpr size_t      FLIGHT_THREADS         = 64;     // Threads recorded at once
+static constexpr bool        FLIGHT_ALL_LEVELS      = false;  // Also record levels below `MIN_LEVEL`
+static constexpr const char *FLIGHT_DUMP_PATH       = "";     // Appended to if set, stderr otherwise
+
+// Structured logging (`ZINFO_KV(msg, "key", value, ...)`, see `zlog/kv.hpp`)
+static constexpr KvEncoding KV_ENCODING  = KvEncoding::Text;  // Default encoder, see `zlog::setKvEncoder`
+static constexpr ANSI       KV_KEY_COLOR = ANSI::Cyan;        // Keys of `KvEncoding::Text` lines
+
+// Runtime module levels (`ZINFO_M(net, ...)`, see `zlog/module.hpp`), also read from the
+// `ZLOG_LEVELS` environment variable at startup, e.g. "net=debug,db=warn,*=info"
+static constexpr const char *MODULE_LEVELS_FILE    = "";    // Watched for changes if set (same syntax)
+static constexpr uint32_t    MODULE_LEVELS_POLL_MS = 1000;  // Watch interval
+static constexpr ANSI        MODULE_COLOR          = ANSI::Blue;
+
+// Metrics (`ZCOUNT`, `ZGAUGE`, `ZHIST`, see `zlog/metrics.hpp`), reported as one line per interval
+static constexpr uint32_t METRICS_INTERVAL_MS    = 10000;  // Report period (0 = only `zlog::reportMetrics()`)
+static constexpr bool     METRICS_REPORT_AT_EXIT = true;   // Report pending changes at exit
+static constexpr bool     METRICS_STRUCTURED     = false;  // Report through the structured encoder (`KV_ENCODING`)
+static constexpr size_t   METRICS_MAX            = 256;    // Further metric names are ignored
+
+// Micro-benchmarks (`ZBENCH(name) { ... }`, see `zlog::runBenchmarks`)
+static constexpr uint32_t BENCH_SAMPLES    = 30;     // Timed samples per benchmark
+static constexpr uint32_t BENCH_SAMPLE_US  = 10000;  // Iterations per sample are calibrated to last this long
+static constexpr uint32_t BENCH_WARMUP_MS  = 100;    // Untimed runs before calibrating
+static constexpr double   BENCH_REGRESSION = 0.10;   // Median slowdown against the baseline that fails (10%)
+
 // Minimum log levels
 static constexpr LogLevel MIN_LVL_RLS = LogLevel::Info;   // Release builds
 static constexpr LogLevel MIN_LVL_DBG = LogLevel::Trace;  // Debug builds
@@ -104,6 +258,10 @@ static constexpr ColorText TRACE_OUT_TAG = {"}--", ANSI::EX_Red};
 static constexpr ColorText TEST_TAG      = {"[TEST]", ANSI::Blue};
 static constexpr ColorText PASS_TAG      = {"[PASS]", ANSI::Green};
 static constexpr ColorText FAIL_TAG      = {"[FAIL]", ANSI::Red};
+static constexpr ColorText BENCH_TAG     = {"[BNCH]", ANSI::Magenta};
+
+// Metrics report tag
+static constexpr ColorText METRICS_TAG   = {"[METR]", ANSI::Cyan};
 
 // Validation tags
 static constexpr ColorText EXPECT_TAG    = {"[EXPC]", ANSI::Yellow};
@@ -115,11 +273,40 @@ static constexpr ColorText PANIC_TAG     = {"[PANC]", ANSI::BG_Red};
 static constexpr std::string_view TAB_TAG  = "    ";  // Indentation
 static constexpr std::string_view TAG_TAG  = " : ";   // Separator
 
+// Prefix stripped from source file paths at compile time (e.g. "/home/me/project/")
+static constexpr std::string_view SOURCE_ROOT = "";
+
 // === END MODIFIABLE VALUES ===
 
 // ANSI reset code
 static constexpr std::string_view COLOR_RESET = "\033[0m";
 
+// Tags rendered at compile time, emitting one is a single copy
+namespace rendered {
+
+static constexpr RenderedText TAG_CTX[] = {
+    prerender(config::TAG_CTX[0]), prerender(config::TAG_CTX[1]),
+    prerender(config::TAG_CTX[2]), prerender(config::TAG_CTX[3]),
+    prerender(config::TAG_CTX[4]), prerender(config::TAG_CTX[5]),
+};
+
+static constexpr RenderedText TRACE_IN_TAG  = prerender(config::TRACE_IN_TAG);
+static constexpr RenderedText TRACE_OUT_TAG = prerender(config::TRACE_OUT_TAG);
+
+static constexpr RenderedText TEST_TAG      = prerender(config::TEST_TAG);
+static constexpr RenderedText PASS_TAG      = prerender(config::PASS_TAG);
+static constexpr RenderedText FAIL_TAG      = prerender(config::FAIL_TAG);
+static constexpr RenderedText BENCH_TAG     = prerender(config::BENCH_TAG);
+
+static constexpr RenderedText METRICS_TAG   = prerender(config::METRICS_TAG);
+
+static constexpr RenderedText EXPECT_TAG    = prerender(config::EXPECT_TAG);
+static constexpr RenderedText ASSERT_TAG    = prerender(config::ASSERT_TAG);
+static constexpr RenderedText VERIFY_TAG    = prerender(config::VERIFY_TAG);
+static constexpr RenderedText PANIC_TAG     = prerender(config::PANIC_TAG);
+
+} // namespace rendered
+
 // Auto-detect build type
 #ifdef NDEBUG
 static constexpr LogLevel MIN_LEVEL = MIN_LVL_RLS; // Release
@@ -136,44 +323,173 @@ static constexpr bool IS_WINDOWS = true;
 static constexpr bool IS_WINDOWS = false;
 #endif
 
+// Flushes pending logs before termination (set to `zlog::flush` by `zlog/log.hpp`)
+inline void (*s_flush_hook)() noexcept = nullptr;
+
 // Process termination (throws in test mode, aborts in production)
 #ifdef ZLOG_T
 inline void killProcess() noexcept {} // Test mode - no termination
 #else
 [[noreturn]]
-inline void killProcess() noexcept { std::abort(); } // Production
+inline void killProcess() noexcept // Production
+{
+    if (s_flush_hook) s_flush_hook();
+    std::abort();
+}
 #endif
 
 } // namespace config
 
+namespace internal {
+
+// True if ANSI colors are emitted, decided once (`ENABLE_COLOR`, and with
+// `DETECT_TTY` only if both stdout and stderr are terminals)
+[[nodiscard]]
+inline bool colorEnabled() noexcept
+{
+    if constexpr (!config::ENABLE_COLOR) return false;
+    else if constexpr (!config::DETECT_TTY) return true;
+    else
+    {
+#ifdef _WIN32
+        static const bool s_color = _isatty(1) && _isatty(2);
+#else
+        static const bool s_color = isatty(1) && isatty(2);
+#endif
+        return s_color;
+    }
+}
+
+// Escape sequence starting each ANSI code, indexed by code
+static constexpr auto ANSI_OPEN = [] {
+    struct Open { char data[8] {}; uint8_t size {0}; };
+    std::array<Open, 108> table {};
+
+    for (int code = 0; code < 108; ++code)
+    {
+        Open &open = table[code];
+        open.data[open.size++] = '\033';
+        open.data[open.size++] = '[';
+        if (code >= 100) open.data[open.size++] = static_cast<char>('0' + code / 100);
+        if (code >= 10)  open.data[open.size++] = static_cast<char>('0' + code / 10 % 10);
+        open.data[open.size++] = static_cast<char>('0' + code % 10);
+        open.data[open.size++] = 'm';
+    }
+
+    return table;
+}();
+
+// Escape sequence starting `color` if colors are enabled
+[[nodiscard]]
+inline std::string_view colorOpen(ANSI color) noexcept
+{
+    if (!colorEnabled()) return {};
+
+    const auto &open = ANSI_OPEN[static_cast<size_t>(color) % ANSI_OPEN.size()];
+    return std::string_view{open.data, open.size};
+}
+
+// `COLOR_RESET` if colors are enabled
+[[nodiscard]]
+inline std::string_view colorReset() noexcept
+{
+    return colorEnabled() ? config::COLOR_RESET : std::string_view{};
+}
+
+// Copy `ct` to `out`, wrapped in its escape codes if colors are enabled
+template <typename Out>
+inline Out putColored(Out out, const ColorText &ct)
+{
+    if (!colorEnabled()) return std::copy(ct.TEXT.begin(), ct.TEXT.end(), out);
+
+    const std::string_view open = colorOpen(ct.COLOR);
+    out = std::copy(open.begin(), open.end(), out);
+    out = std::copy(ct.TEXT.begin(), ct.TEXT.end(), out);
+    return std::copy(config::COLOR_RESET.begin(), config::COLOR_RESET.end(), out);
+}
+
+// Pre-rendered bytes of `rt` for the current color mode
+[[nodiscard]]
+inline std::string_view view(const RenderedText &rt) noexcept
+{
+    return colorEnabled() ? rt.colored() : rt.plain();
+}
+
+} // namespace internal
+
 // Output ColorText to stream (respects ENABLE_COLOR config)
 inline std::ostream &operator<<(std::ostream &os, const ColorText &ct)
 {
-    if constexpr (!config::ENABLE_COLOR) return os << ct.TEXT;
-    return os << "\033[" << static_cast<int>(ct.COLOR) << "m" << ct.TEXT << "\033[0m";
+    internal::putColored(std::ostreambuf_iterator<char>{os}, ct);
+    return os;
+}
+
+// Output pre-rendered text to stream
+inline std::ostream &operator<<(std::ostream &os, const RenderedText &rt)
+{
+    return os << internal::view(rt);
+}
+
+namespace internal {
+
+// `file` without `config::SOURCE_ROOT`
+[[nodiscard]]
+consteval const char *stripSourceRoot(const char *file) noexcept
+{
+    return std::string_view{file}.starts_with(config::SOURCE_ROOT) ? file + config::SOURCE_ROOT.size() : file;
 }
 
-// Source code location tracking
+} // namespace internal
+
+// Source code location tracking, formatted as "[FILE:LINE]" only when printed
 struct SourceLoc {
-    const bool        EMPTY;  //< True if default-constructed
-    const std::string TEXT;   //< Formatted as "[FILE:LINE]"
+    const char    *FILE     {nullptr};  //< nullptr if default-constructed
+    const char    *FUNCTION {nullptr};
+    const uint32_t LINE     {0};
+    const uint32_t COLUMN   {0};
 
     // Empty location
-    SourceLoc() : EMPTY{true}, TEXT {""} {}
+    constexpr SourceLoc() noexcept = default;
 
     // Create from file and line
-    SourceLoc(std::string_view file, int line)
-        : EMPTY{false}
-        , TEXT{std::format("[{}:{}]", file, line)}
+    constexpr SourceLoc(const char *file, uint32_t line) noexcept
+        : FILE{file}
+        , LINE{line}
     {}
 
+    // Location of the caller, with `config::SOURCE_ROOT` stripped at compile time
+    [[nodiscard]]
+    static consteval SourceLoc current(std::source_location loc = std::source_location::current()) noexcept
+    {
+        return SourceLoc{internal::stripSourceRoot(loc.file_name()), loc.function_name(), loc.line(), loc.column()};
+    }
+
+    // True if default-constructed
+    [[nodiscard]]
+    constexpr bool isEmpty() const noexcept { return FILE == nullptr; }
+
     // Output location in gray
     friend std::ostream &operator<<(std::ostream &os, const SourceLoc &sl)
     {
-        return sl.EMPTY ? os : os << ColorText{sl.TEXT, ANSI::EX_Black};
+        if (sl.isEmpty()) return os;
+
+        return os
+            << internal::colorOpen(ANSI::EX_Black)
+            << '[' << sl.FILE << ':' << sl.LINE << ']'
+            << internal::colorReset();
     }
+
+private:
+    constexpr SourceLoc(const char *file, const char *function, uint32_t line, uint32_t column) noexcept
+        : FILE{file}
+        , FUNCTION{function}
+        , LINE{line}
+        , COLUMN{column}
+    {}
 };
 
+static_assert(std::is_trivially_copyable_v<SourceLoc>);
+
 } // namespace zlog
 
 // std::format support for ColorText
@@ -183,13 +499,19 @@ struct std::formatter<zlog::ColorText> {
 
     auto format(const zlog::ColorText &color_text, std::format_context &ctx) const
     {
-        return (!zlog::config::ENABLE_COLOR)
-        ? std::format_to(ctx.out(), "{}", color_text.TEXT)
-        : std::format_to(
-            ctx.out(),
-            "\033[{}m{}\033[0m",
-            static_cast<int>(color_text.COLOR), color_text.TEXT
-        );
+        return zlog::internal::putColored(ctx.out(), color_text);
+    }
+};
+
+// std::format support for RenderedText
+template <>
+struct std::formatter<zlog::RenderedText> {
+    constexpr auto parse(std::format_parse_context &ctx) { return ctx.begin(); }
+
+    auto format(const zlog::RenderedText &rt, std::format_context &ctx) const
+    {
+        const std::string_view bytes = zlog::internal::view(rt);
+        return std::copy(bytes.begin(), bytes.end(), ctx.out());
     }
 };
 
@@ -200,11 +522,14 @@ struct std::formatter<zlog::SourceLoc> {
 
     auto format(const zlog::SourceLoc &loc, std::format_context &ctx) const
     {
-        return std::format_to(
-            ctx.out(),
-            "{}",
-            zlog::ColorText{loc.TEXT, zlog::ANSI::EX_Black}
-        );
+        if (loc.isEmpty()) return ctx.out();
+
+        const std::string_view open  = zlog::internal::colorOpen(zlog::ANSI::EX_Black);
+        const std::string_view reset = zlog::internal::colorReset();
+
+        auto out = std::copy(open.begin(), open.end(), ctx.out());
+        out = std::format_to(out, "[{}:{}]", loc.FILE, loc.LINE);
+        return std::copy(reset.begin(), reset.end(), out);
     }
 };
 
@@ -212,4 +537,4 @@ struct std::formatter<zlog::SourceLoc> {
 
 // Create `SourceLoc` for current location
 #define _ZSL \
-    { ::zlog::SourceLoc {__FILE__, __LINE__} }
+    (::zlog::SourceLoc::current())
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./os.hpp"
+#include "./prostring.hpp"
+#include "./timestamp.hpp"
+
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+
+namespace zlog {
+
+namespace internal {
+
+static_assert(config::FLIGHT_RECORD_BYTES <= UINT16_MAX, "FLIGHT_RECORD_BYTES must fit in 16 bits");
+
+// One recorded message, `seq` is 0 while it is being written (seqlock)
+struct FlightRecord {
+    std::atomic<uint64_t> seq     {0};  //< Ring position + 1 once complete
+    uint64_t              time_ns {0};  //< Since `s_start_time`
+    uint32_t              tid     {0};  //< Recorder thread number of the writer
+    LogLevel              level   {LogLevel::Trace};
+    uint16_t              len     {0};
+    char                  text[config::FLIGHT_RECORD_BYTES];
+};
+
+// Preallocated ring of one thread's last records, reused by a later thread once its owner exits
+struct FlightRing {
+    std::atomic<bool>     owned  {false};
+    std::atomic<uint64_t> head   {0};  //< Records ever written
+    std::atomic<uint64_t> dumped {0};  //< `head` at the last dump
+    FlightRecord          records[config::FLIGHT_RECORDS];
+};
+
+// Always-on record of the last messages of every thread, written out on fatal errors
+// and crash signals using only async-signal-safe calls (rings are never freed)
+class FlightRecorder final {
+    inline static constinit std::atomic<FlightRing *> s_rings[config::FLIGHT_THREADS] {};
+    inline static constinit std::atomic<uint32_t>     s_next_tid {1};
+    inline static constinit std::atomic<bool>         s_dumping  {false};
+    inline static thread_local bool                   s_destroyed = false;
+
+    // Ring of the calling thread, released at thread exit
+    struct ThreadRing {
+        FlightRing *ring {nullptr};
+        uint32_t    tid  {s_next_tid.fetch_add(1, std::memory_order_relaxed)};
+
+        ThreadRing() noexcept : ring{_claim()} {}
+
+        ~ThreadRing()
+        {
+            if (ring) ring->owned.store(false, std::memory_order_release);
+            s_destroyed = true;
+        }
+    };
+
+    // Take a new ring while slots are left (keeping the records of exited threads), then
+    // reuse a released one, nullptr if all `FLIGHT_THREADS` are in use
+    static FlightRing *_claim() noexcept
+    {
+        for (std::atomic<FlightRing *> &slot : s_rings)
+        {
+            if (slot.load(std::memory_order_acquire)) continue;
+
+            FlightRing *fresh = new (std::nothrow) FlightRing {};
+            if (!fresh) break;
+
+            fresh->owned.store(true, std::memory_order_relaxed);
+
+            FlightRing *empty = nullptr;
+            if (slot.compare_exchange_strong(empty, fresh, std::memory_order_acq_rel)) return fresh;
+            delete fresh;  // Lost the slot to another thread
+        }
+
+        for (std::atomic<FlightRing *> &slot : s_rings)
+        {
+            FlightRing *ring = slot.load(std::memory_order_acquire);
+            bool expected = false;
+
+            if (ring && ring->owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                return ring;
+        }
+
+        return nullptr;
+    }
+
+    // Writes `value` in decimal, returns the digits written
+    static size_t _putUint(char *out, uint64_t value) noexcept
+    {
+        char digits[20];
+        size_t n = 0;
+
+        do digits[n++] = static_cast<char>('0' + value % 10);
+        while ((value /= 10) != 0);
+
+        for (size_t i = 0; i < n; ++i) out[i] = digits[n - 1 - i];
+        return n;
+    }
+
+    // Write one record as "[+sec.micros] [T<tid>] [LEVL] : text", false if it was overwritten meanwhile
+    static bool _writeRecord(int fd, const FlightRecord &rec, uint64_t pos) noexcept
+    {
+        char line[config::FLIGHT_RECORD_BYTES + 64];
+        size_t len = 0;
+
+        const uint64_t us = rec.time_ns / 1000;
+        line[len++] = '[';
+        line[len++] = '+';
+        len += _putUint(line + len, us / 1'000'000);
+        line[len++] = '.';
+        putDigits(line + len, us % 1'000'000, 6);
+        len += 6;
+
+        std::memcpy(line + len, "] [T", 4);
+        len += 4;
+        len += _putUint(line + len, rec.tid);
+        line[len++] = ']';
+        line[len++] = ' ';
+
+        const std::string_view tag = config::TAG_CTX[static_cast<int>(rec.level)].TEXT;
+        std::memcpy(line + len, tag.data(), tag.size());
+        len += tag.size();
+        std::memcpy(line + len, " : ", 3);
+        len += 3;
+
+        const size_t text_len = std::min<size_t>(rec.len, config::FLIGHT_RECORD_BYTES);
+        std::memcpy(line + len, rec.text, text_len);
+        len += text_len;
+        line[len++] = '\n';
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (rec.seq.load(std::memory_order_relaxed) != pos + 1) return false;
+
+        return writeFdRaw(fd, {line, len});
+    }
+
+    static void _onSignal(int sig) noexcept
+    {
+        std::signal(sig, SIG_DFL);
+
+        char reason[32] = "signal ";
+        const size_t len = 7 + _putUint(reason + 7, static_cast<uint64_t>(sig));
+        dump({reason, len});
+
+        std::raise(sig);
+    }
+
+public:
+    // Record filtered levels too (`config::FLIGHT_ALL_LEVELS`)
+    static constexpr bool KEEPS_FILTERED =
+        config::ENABLE_FLIGHT_RECORDER && config::FLIGHT_ALL_LEVELS && !config::DISABLE_LOGGING;
+
+    // Add a message to the calling thread's ring (truncated to `FLIGHT_RECORD_BYTES`)
+    static void record(LogLevel lvl, std::string_view text) noexcept
+    {
+        if (s_destroyed) return;
+
+        thread_local ThreadRing s_ring {};
+        FlightRing *ring = s_ring.ring;
+        const uint32_t tid = s_ring.tid;
+        if (!ring) return;
+
+        const uint64_t pos = ring->head.load(std::memory_order_relaxed);
+        FlightRecord &rec = ring->records[pos % config::FLIGHT_RECORDS];
+
+        rec.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        rec.time_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - s_start_time
+        ).count());
+        rec.tid   = tid;
+        rec.level = lvl;
+        rec.len   = static_cast<uint16_t>(std::min(text.size(), config::FLIGHT_RECORD_BYTES));
+        std::memcpy(rec.text, text.data(), rec.len);
+
+        rec.seq.store(pos + 1, std::memory_order_release);
+        ring->head.store(pos + 1, std::memory_order_release);
+    }
+
+    // Write the records added since the last dump, oldest first over all threads
+    // (async-signal-safe, skipped if another dump is running)
+    static void dump(std::string_view reason) noexcept
+    {
+        if (s_dumping.exchange(true, std::memory_order_acquire)) return;
+
+        uint64_t next[config::FLIGHT_THREADS] {};
+        uint64_t end[config::FLIGHT_THREADS] {};
+        bool any = false;
+
+        for (size_t i = 0; i < config::FLIGHT_THREADS; ++i)
+        {
+            FlightRing *ring = s_rings[i].load(std::memory_order_acquire);
+            if (!ring) continue;
+
+            end[i]  = ring->head.load(std::memory_order_acquire);
+            next[i] = std::max(ring->dumped.exchange(end[i], std::memory_order_relaxed),
+                               end[i] > config::FLIGHT_RECORDS ? end[i] - config::FLIGHT_RECORDS : 0);
+            any = any || next[i] < end[i];
+        }
+
+        if (any)
+        {
+            int fd = FD_ERR;
+
+            if constexpr (std::string_view{config::FLIGHT_DUMP_PATH}.size() > 0)
+            {
+#ifdef _WIN32
+                const int file = _open(config::FLIGHT_DUMP_PATH, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, 0644);
+#else
+                const int file = ::open(config::FLIGHT_DUMP_PATH, O_WRONLY | O_CREAT | O_APPEND, 0644);
+#endif
+                if (file >= 0) fd = file;
+            }
+
+            writeFdRaw(fd, "\n=== ZLOG FLIGHT RECORDER (");
+            writeFdRaw(fd, reason);
+            writeFdRaw(fd, ") ===\n");
+
+            // Merge the rings by time
+            while (true)
+            {
+                size_t best = config::FLIGHT_THREADS;
+                uint64_t best_time = UINT64_MAX;
+
+                for (size_t i = 0; i < config::FLIGHT_THREADS; ++i)
+                {
+                    if (next[i] >= end[i]) continue;
+
+                    const FlightRing *ring = s_rings[i].load(std::memory_order_relaxed);
+                    const uint64_t time = ring->records[next[i] % config::FLIGHT_RECORDS].time_ns;
+                    if (time < best_time) best = i, best_time = time;
+                }
+
+                if (best == config::FLIGHT_THREADS) break;
+
+                const FlightRing *ring = s_rings[best].load(std::memory_order_relaxed);
+                const uint64_t pos = next[best]++;
+                const FlightRecord &rec = ring->records[pos % config::FLIGHT_RECORDS];
+
+                if (rec.seq.load(std::memory_order_acquire) == pos + 1)
+                    _writeRecord(fd, rec, pos);
+            }
+
+            writeFdRaw(fd, "=== END FLIGHT RECORDER ===\n");
+
+#ifdef _WIN32
+            if (fd != FD_ERR) _close(fd);
+#else
+            if (fd != FD_ERR) ::close(fd);
+#endif
+        }
+
+        s_dumping.store(false, std::memory_order_release);
+    }
+
+    // Dump on SIGSEGV, SIGABRT, SIGFPE and SIGILL, then let the signal terminate the process
+    static bool installHandlers() noexcept
+    {
+        for (const int sig : {SIGSEGV, SIGABRT, SIGFPE, SIGILL}) std::signal(sig, _onSignal);
+        return true;
+    }
+};
+
+// Record a message below `MIN_LEVEL` (`config::FLIGHT_ALL_LEVELS`)
+inline void flightRecord(LogLevel lvl, const ProString &msg) noexcept
+{
+    FlightRecorder::record(lvl, msg.view());
+}
+
+// Crash handlers are set up before `main` when the recorder is enabled
+inline const bool s_flight_handlers_set = config::ENABLE_FLIGHT_RECORDER && FlightRecorder::installHandlers();
+
+} // namespace internal
+
+// Write the records logged since the last dump (`config::ENABLE_FLIGHT_RECORDER`)
+inline void dumpFlightRecorder() noexcept
+{
+    internal::FlightRecorder::dump("requested");
+}
+
+} // namespace zlog
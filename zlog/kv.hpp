@@ -0,0 +1,339 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./log.hpp"
+#include "./prostring.hpp"
+#include "./site.hpp"
+#include "./timeline.hpp"
+#include "./timestamp.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <charconv>
+#include <iterator>
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+
+namespace zlog {
+
+// Typed value of a structured field, strings are borrowed for the duration of the call
+struct KvValue {
+    enum class Type : uint8_t { Bool, Int, Uint, Float, String };
+
+    const Type TYPE;
+
+    union {
+        bool             b;
+        int64_t          i;
+        uint64_t         u;
+        double           f;
+        std::string_view s;
+    };
+
+    constexpr explicit KvValue(bool value)             noexcept : TYPE{Type::Bool}  , b{value} {}
+    constexpr explicit KvValue(int64_t value)          noexcept : TYPE{Type::Int}   , i{value} {}
+    constexpr explicit KvValue(uint64_t value)         noexcept : TYPE{Type::Uint}  , u{value} {}
+    constexpr explicit KvValue(double value)           noexcept : TYPE{Type::Float} , f{value} {}
+    constexpr explicit KvValue(std::string_view value) noexcept : TYPE{Type::String}, s{value} {}
+};
+
+// Serializes structured lines: `begin` once, `field` per key/value pair, then `end`
+class KvEncoder {
+public:
+    virtual ~KvEncoder() = default;
+
+    virtual void begin(std::string &out, LogLevel lvl, std::string_view msg) const = 0;
+    virtual void field(std::string &out, std::string_view key, const KvValue &value) const = 0;
+
+    // Terminate the line (must end with a new line)
+    virtual void end(std::string &out) const { out += '\n'; }
+};
+
+namespace internal {
+
+// Lowercase level names of structured lines
+inline constexpr std::string_view KV_LEVEL_NAMES[] = {"trace", "debug", "info", "warn", "error", "fatal"};
+
+// Timestamp without its brackets
+[[nodiscard]]
+inline std::string_view kvTimestamp() noexcept
+{
+    const std::string_view stamp = getTimestamp();
+    return stamp.substr(1, stamp.size() - 2);
+}
+
+// Appends a non-string value as plain text ("true", "-12", "0.25", ...)
+inline void putKvScalar(std::string &out, const KvValue &value)
+{
+    char buf[32];
+    std::to_chars_result result {buf, {}};
+
+    switch (value.TYPE)
+    {
+    case KvValue::Type::Bool:   out += value.b ? "true" : "false"; return;
+    case KvValue::Type::Int:    result = std::to_chars(buf, buf + sizeof(buf), value.i); break;
+    case KvValue::Type::Uint:   result = std::to_chars(buf, buf + sizeof(buf), value.u); break;
+    case KvValue::Type::Float:  result = std::to_chars(buf, buf + sizeof(buf), value.f); break;
+    case KvValue::Type::String: out += value.s; return;
+    }
+
+    out.append(buf, result.ptr);
+}
+
+// Appends `text` bare, or quoted and escaped if it is empty or holds spaces, '=' or quotes (logfmt rules)
+inline void putLogfmtText(std::string &out, std::string_view text)
+{
+    const bool quote = text.empty() || std::ranges::any_of(text, [](char ch) {
+        return static_cast<unsigned char>(ch) <= ' ' || ch == '=' || ch == '"' || ch == '\\';
+    });
+
+    if (!quote)
+    {
+        out += text;
+        return;
+    }
+
+    out += '"';
+    putJsonEscaped(out, text);
+    out += '"';
+}
+
+// Appends `value` following logfmt rules
+inline void putLogfmtValue(std::string &out, const KvValue &value)
+{
+    if (value.TYPE == KvValue::Type::String) putLogfmtText(out, value.s);
+    else putKvScalar(out, value);
+}
+
+} // namespace internal
+
+// [INFO] : message key=value (keys colored with `config::KV_KEY_COLOR`)
+class TextKvEncoder final : public KvEncoder {
+public:
+    void begin(std::string &out, LogLevel lvl, std::string_view msg) const override
+    {
+        internal::_renderPrefix(out, lvl, {});
+        out += msg;
+    }
+
+    void field(std::string &out, std::string_view key, const KvValue &value) const override
+    {
+        out += ' ';
+        internal::putColored(std::back_inserter(out), ColorText{key, config::KV_KEY_COLOR});
+        out += '=';
+        internal::putLogfmtValue(out, value);
+    }
+};
+
+// ts=... level=info msg="message" key=value
+class LogfmtKvEncoder final : public KvEncoder {
+public:
+    void begin(std::string &out, LogLevel lvl, std::string_view msg) const override
+    {
+        if constexpr (config::ENABLE_TIMESTAMP)
+        {
+            out += "ts=";
+            internal::putLogfmtText(out, internal::kvTimestamp());
+            out += ' ';
+        }
+
+        out += "level=";
+        out += internal::KV_LEVEL_NAMES[static_cast<int>(lvl)];
+        out += " msg=";
+        internal::putLogfmtText(out, msg);
+    }
+
+    void field(std::string &out, std::string_view key, const KvValue &value) const override
+    {
+        out += ' ';
+        out += key;
+        out += '=';
+        internal::putLogfmtValue(out, value);
+    }
+};
+
+// {"ts":"...","level":"info","msg":"message","key":value} (one object per line)
+class JsonKvEncoder final : public KvEncoder {
+public:
+    void begin(std::string &out, LogLevel lvl, std::string_view msg) const override
+    {
+        out += '{';
+
+        if constexpr (config::ENABLE_TIMESTAMP)
+        {
+            out += R"("ts":")";
+            internal::putJsonEscaped(out, internal::kvTimestamp());
+            out += R"(",)";
+        }
+
+        out += R"("level":")";
+        out += internal::KV_LEVEL_NAMES[static_cast<int>(lvl)];
+        out += R"(","msg":")";
+        internal::putJsonEscaped(out, msg);
+        out += '"';
+    }
+
+    void field(std::string &out, std::string_view key, const KvValue &value) const override
+    {
+        out += R"(,")";
+        internal::putJsonEscaped(out, key);
+        out += R"(":)";
+
+        switch (value.TYPE)
+        {
+        case KvValue::Type::String:
+            out += '"';
+            internal::putJsonEscaped(out, value.s);
+            out += '"';
+            break;
+
+        case KvValue::Type::Float:
+            // JSON has no NaN or infinity
+            if (value.f - value.f != 0.0)
+            {
+                out += '"';
+                internal::putKvScalar(out, value);
+                out += '"';
+                break;
+            }
+            [[fallthrough]];
+
+        default:
+            internal::putKvScalar(out, value);
+        }
+    }
+
+    void end(std::string &out) const override { out += "}\n"; }
+};
+
+// Builtin encoder of `encoding`
+[[nodiscard]]
+inline std::shared_ptr<const KvEncoder> makeKvEncoder(KvEncoding encoding)
+{
+    switch (encoding)
+    {
+    case KvEncoding::Logfmt: return std::make_shared<LogfmtKvEncoder>();
+    case KvEncoding::Json:   return std::make_shared<JsonKvEncoder>();
+    default:                 return std::make_shared<TextKvEncoder>();
+    }
+}
+
+namespace internal {
+
+// Current encoder of structured lines, never destroyed so it outlives static destruction
+[[nodiscard]]
+inline std::atomic<std::shared_ptr<const KvEncoder>> &kvEncoder() noexcept
+{
+    static auto *s_encoder = new std::atomic<std::shared_ptr<const KvEncoder>> {makeKvEncoder(config::KV_ENCODING)};
+    return *s_encoder;
+}
+
+// Encode one field, capturing `value` by type (other types are formatted as strings)
+template <typename T>
+inline void _kvField(const KvEncoder &encoder, std::string &out, std::string_view key, const T &value)
+{
+    using V = std::remove_cvref_t<T>;
+
+    if constexpr (std::is_same_v<V, bool>)
+        encoder.field(out, key, KvValue{value});
+    else if constexpr (std::is_same_v<V, char>)
+        encoder.field(out, key, KvValue{std::string_view{&value, 1}});
+    else if constexpr (std::is_enum_v<V>)
+        _kvField(encoder, out, key, static_cast<std::underlying_type_t<V>>(value));
+    else if constexpr (std::is_integral_v<V> && std::is_signed_v<V>)
+        encoder.field(out, key, KvValue{static_cast<int64_t>(value)});
+    else if constexpr (std::is_integral_v<V>)
+        encoder.field(out, key, KvValue{static_cast<uint64_t>(value)});
+    else if constexpr (std::is_floating_point_v<V>)
+        encoder.field(out, key, KvValue{static_cast<double>(value)});
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+        encoder.field(out, key, KvValue{std::string_view{value}});
+    else
+    {
+        const ProString text {"{}", value};
+        encoder.field(out, key, KvValue{text.view()});
+    }
+}
+
+inline void _kvFields(const KvEncoder&, std::string&) {}
+
+template <typename K, typename V, typename... Rest>
+inline void _kvFields(const KvEncoder &encoder, std::string &out, const K &key, const V &value, const Rest&... rest)
+{
+    static_assert(std::is_convertible_v<const K&, std::string_view>, "structured field keys must be strings");
+
+    _kvField(encoder, out, key, value);
+    _kvFields(encoder, out, rest...);
+}
+
+// Log `msg` with its `key, value, ...` fields through the current encoder
+template <typename... Fields>
+inline void kvLog(LogSite &site, std::string_view msg, const Fields&... fields) noexcept
+{
+    static_assert(sizeof...(Fields) % 2 == 0, "structured fields come in key, value pairs");
+
+    _logSiteSummary(site);
+
+    const std::shared_ptr<const KvEncoder> encoder = kvEncoder().load(std::memory_order_acquire);
+
+    thread_local std::string s_line {};
+    s_line.clear();
+
+    {
+        const StatsTimer<LogTiming::Render> timer {};
+        encoder->begin(s_line, site.LEVEL, msg);
+        _kvFields(*encoder, s_line, fields...);
+        encoder->end(s_line);
+    }
+
+    if constexpr (config::ENABLE_FLIGHT_RECORDER)
+        FlightRecorder::record(site.LEVEL, std::string_view{s_line}.substr(0, s_line.size() - 1));
+
+    if constexpr (config::ENABLE_BINARY_LOG)
+        binaryLogText(site.LEVEL, std::string_view{s_line}.substr(0, s_line.size() - 1));
+    else _writeLine(site.LEVEL, s_line);
+
+    if constexpr (config::ENABLE_FLIGHT_RECORDER)
+        if (site.LEVEL == LogLevel::Fatal) FlightRecorder::dump("fatal");
+}
+
+} // namespace internal
+
+// Serialize structured lines with `encoder`
+inline void setKvEncoder(std::shared_ptr<const KvEncoder> encoder) noexcept
+{
+    internal::kvEncoder().store(std::move(encoder), std::memory_order_release);
+}
+
+// Serialize structured lines with the builtin encoder of `encoding`
+inline void setKvEncoder(KvEncoding encoding)
+{
+    setKvEncoder(makeKvEncoder(encoding));
+}
+
+} // namespace zlog
+
+/// MACROS:
+
+// Logs `MSG` with typed `"key", value` fields, filtered and limited like `_ZLOG`
+#define _ZLOG_KV(LVL, TAG, MSG, ...) do {                                        \
+    if constexpr (!::zlog::internal::isEnabled(LVL)) {}                          \
+    else                                                                         \
+    {                                                                            \
+        static constinit ::zlog::LogSite _zlog_site {                            \
+            LVL, _ZSL, ::zlog::internal::siteFormat(#MSG), TAG                   \
+        };                                                                       \
+        if (::zlog::internal::hitSite(_zlog_site))                               \
+            ::zlog::internal::kvLog(_zlog_site, MSG __VA_OPT__(,) __VA_ARGS__);  \
+    }                                                                            \
+} while (0)
+
+// Structured logging
+#define   ZDBG_KV(MSG, ...)  _ZLOG_KV(::zlog::LogLevel::Debug,   "ZDBG", MSG __VA_OPT__(,) __VA_ARGS__)
+#define  ZINFO_KV(MSG, ...)  _ZLOG_KV(::zlog::LogLevel::Info ,  "ZINFO", MSG __VA_OPT__(,) __VA_ARGS__)
+#define  ZWARN_KV(MSG, ...)  _ZLOG_KV(::zlog::LogLevel::Warn ,  "ZWARN", MSG __VA_OPT__(,) __VA_ARGS__)
+#define   ZERR_KV(MSG, ...)  _ZLOG_KV(::zlog::LogLevel::Error,   "ZERR", MSG __VA_OPT__(,) __VA_ARGS__)
+#define ZFATAL_KV(MSG, ...)  _ZLOG_KV(::zlog::LogLevel::Fatal, "ZFATAL", MSG __VA_OPT__(,) __VA_ARGS__)
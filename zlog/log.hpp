@@ -1,12 +1,20 @@
 #pragma once
 
 #include "./config.hpp"
+#include "./prostring.hpp"
+#include "./async.hpp"
+#include "./binary.hpp"
+#include "./flight.hpp"
+#include "./sink.hpp"
+#include "./site.hpp"
+#include "./stats.hpp"
+#include "./timestamp.hpp"
 
-#include <ctime>
-#include <mutex>
 #include <chrono>
 #include <format>
+#include <string>
 #include <utility>
+#include <iterator>
 #include <iostream>
 #include <string_view>
 
@@ -14,102 +22,163 @@ namespace zlog {
 
 namespace internal {
 
-// String class which supports regular and format strings
-class ProString final {
-public:
-    const std::string TEXT;
-
-    ProString() noexcept : TEXT {""} {}
+// True if `lvl` passes the compile-time filter
+[[nodiscard]]
+constexpr bool isEnabled(LogLevel lvl) noexcept
+{
+    return !config::DISABLE_LOGGING && lvl >= config::MIN_LEVEL;
+}
 
-    // Regular string constructor
-    ProString(std::string_view text) noexcept : TEXT {text} {}
+// Appends the colored timestamp, level and `module` tags of a log line to `line`
+inline void _renderPrefix(std::string &line, LogLevel lvl, std::string_view module)
+{
+    line += colorReset();
 
-    // Format string constructor
-    template <typename... Args>
-    ProString(std::format_string<Args...> f_str, Args&&... args) noexcept
-    : TEXT {std::format(f_str, std::forward<Args>(args)...)}
-    {}
+    if constexpr (config::ENABLE_TIMESTAMP)
+    {
+        putColored(std::back_inserter(line), ColorText{getTimestamp(), ANSI::EX_Black});
+        line += config::TAG_TAG;
+    }
 
-    // True is no text is provided
-    [[nodiscard]]
-    constexpr bool isEmpty() const noexcept { return TEXT == ""; }
+    line += view(config::rendered::TAG_CTX[static_cast<int>(lvl)]);
+    line += config::TAG_TAG;
 
-    // Ostream support
-    friend std::ostream &operator<<(std::ostream &os, const ProString &ps)
+    if (!module.empty())
     {
-        return os << ps.TEXT;
+        putColored(std::back_inserter(line), ColorText{module, config::MODULE_COLOR});
+        line += config::TAG_TAG;
     }
-};
+}
 
-// Thread-safe logging guard with mutex lock
-struct LogGuard {
-    std::scoped_lock<std::mutex> lock;  //< RAII mutex lock
-    std::ostream&                os;    //< Reference to output stream
+// Appends a complete log line to `line` (with the `module` tag if set)
+inline void _renderLine(std::string &line, LogLevel lvl, const ProString &msg, std::string_view module)
+{
+    _renderPrefix(line, lvl, module);
+    line += msg.view();
+    line += '\n';
+}
 
-    LogGuard(std::mutex& mutex, std::ostream& os) : lock{mutex}, os{os} {}
-};
+// While set, lines logged by the calling thread are appended here instead of being
+// written (output capture of `zlog::runTests`)
+inline thread_local std::string *s_capture = nullptr;
 
-// Returns thread-safe `LogGuard` for logging
-[[nodiscard]]
-inline LogGuard logStream(LogLevel level) noexcept
+// Hand a rendered line (ending with a new line) to the writer thread or the sinks
+inline void _writeLine(LogLevel lvl, const std::string &line) noexcept
 {
-    static std::mutex s_log_mutex {};
-
-    // Use cout for Trace/Debug/Info, cerr for Warn/Error/Fatal
-    return LogGuard {
-        s_log_mutex,
-        static_cast<int>(level) < static_cast<int>(LogLevel::Warn)
-        ? std::cout
-        : std::cerr
-    };
+    if (s_capture) [[unlikely]]
+    {
+        *s_capture += line;
+        return;
+    }
+
+    if constexpr (config::ENABLE_LOG_STATS) LogStatsRegistry::instance().line(lvl, line.size());
+    const StatsTimer<LogTiming::Dispatch> timer {};
+
+    if constexpr (config::ENABLE_ASYNC)
+    {
+        // Short lines are queued inline, without touching the heap
+        AsyncLogger &logger = AsyncLogger::instance();
+        logger.push(lvl, ProString{line});
+
+        if (lvl == LogLevel::Fatal) logger.flush();
+    }
+    else
+    {
+        // Rendered once, shared by every sink
+        SinkRegistry::instance().dispatch(LogRecord{lvl, line});
+    }
 }
 
-// Returns current timestamp as "[HH:MM:SS]" string
-[[nodiscard]]
-static inline std::string_view getTimestamp() noexcept
+// Internal log function (`module` is the "[name]" tag of a `LogModule`)
+inline void _log(LogLevel lvl, const ProString &msg, std::string_view module = {}) noexcept
 {
-    auto now = std::chrono::system_clock::now();
-    std::time_t t = std::chrono::system_clock::to_time_t(now);
-    std::tm tm_struct{};
+    if (!isEnabled(lvl)) return;
+    if constexpr (config::ENABLE_FLIGHT_RECORDER) FlightRecorder::record(lvl, msg.view());
+
+    if constexpr (config::ENABLE_BINARY_LOG)
+    {
+        binaryLogText(lvl, msg.view());
+    }
+    else
+    {
+        thread_local std::string s_line {};
+        s_line.clear();
+
+        {
+            const StatsTimer<LogTiming::Render> timer {};
+            _renderLine(s_line, lvl, msg, module);
+        }
+
+        _writeLine(lvl, s_line);
+    }
 
-    thread_local char buf[sizeof("[HH:MM:SS]")] {};
+    // `ZFATAL`, `ZPANIC` and `critical()` end up here
+    if constexpr (config::ENABLE_FLIGHT_RECORDER)
+        if (lvl == LogLevel::Fatal) FlightRecorder::dump("fatal");
+}
 
-#ifdef _WIN32
-    localtime_s(&tm_struct, &t);
-#else
-    localtime_r(&t, &tm_struct);
-#endif
+// Log the repeats collapsed and the lines suppressed at `site` since its last line
+inline void _logSiteSummary(LogSite &site, std::string_view module = {}) noexcept
+{
+    if (site.repeats.load(std::memory_order_relaxed) != 0)
+    {
+        if (const uint64_t repeats = site.repeats.exchange(0, std::memory_order_relaxed))
+            _log(site.LEVEL, {"last message of {} repeated {} times", site.LOC, repeats}, module);
+    }
 
-    std::strftime(buf, sizeof(buf), "[%H:%M:%S]", &tm_struct);
-    return std::string_view{buf, sizeof("[HH:MM:SS]")};
+    if (site.suppressed.load(std::memory_order_relaxed) != 0)
+    {
+        if (const uint64_t suppressed = site.suppressed.exchange(0, std::memory_order_relaxed))
+            _log(site.LEVEL, {"{} lines of {} suppressed by its rate limit", suppressed, site.LOC}, module);
+    }
 }
 
-// Internal log function
-inline void _log(LogLevel lvl, ProString msg) noexcept
+// FNV-1a hash of a message (never 0, the value of a site that logged nothing)
+[[nodiscard]]
+inline uint64_t _messageHash(std::string_view text) noexcept
 {
-    if (config::DISABLE_LOGGING || lvl < config::MIN_LEVEL) return;
+    uint64_t hash = 14695981039346656037ull;
 
-    LogGuard log_gaurd = internal::logStream(lvl);
-    log_gaurd.os << config::COLOR_RESET;
+    for (const char ch : text)
+    {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 1099511628211ull;
+    }
 
-    if constexpr (config::ENABLE_TIMESTAMP)
+    return hash | 1;
+}
+
+// Log a line of `site`, collapsing repeats of its last line (`config::COLLAPSE_REPEATS`)
+inline void _log(LogSite &site, const ProString &msg, std::string_view module = {}) noexcept
+{
+    if constexpr (config::COLLAPSE_REPEATS)
     {
-        log_gaurd.os
-        << ColorText{internal::getTimestamp(), ANSI::EX_Black}
-        << config::TAG_TAG;
+        const uint64_t hash = _messageHash(msg.view());
+        const auto now_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - s_start_time
+        ).count());
+
+        if (site.last_hash.load(std::memory_order_relaxed) == hash
+            && now_ms - site.last_ms.load(std::memory_order_relaxed) < config::COLLAPSE_WINDOW_MS)
+        {
+            site.repeats.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        site.last_hash.store(hash, std::memory_order_relaxed);
+        site.last_ms.store(now_ms, std::memory_order_relaxed);
     }
 
-    log_gaurd.os
-    << config::TAG_CTX[static_cast<int>(lvl)]
-    << config::TAG_TAG << msg << "\n";
+    _logSiteSummary(site, module);
+    _log(site.LEVEL, msg, module);
 }
 
 } // namespace internal
 
 // Macro to generate logging functions for each level
-#define _LOG_FN(FN_NAME, LOG_LVL)                     \
-    inline void FN_NAME(internal::ProString message)  \
-    { ::zlog::internal::_log(LOG_LVL, message); }     \
+#define _LOG_FN(FN_NAME, LOG_LVL)                            \
+    inline void FN_NAME(const internal::ProString &message)  \
+    { ::zlog::internal::_log(LOG_LVL, message); }            \
 
     // Generate logging functions for each level
     _LOG_FN(trace, LogLevel::Trace)
@@ -121,30 +190,85 @@ inline void _log(LogLevel lvl, ProString msg) noexcept
 
 #undef _LOG_FN
 
-} // namespace zlog
+// Waits until every pending log record has been written (including pending
+// repeat and rate limit summaries)
+inline void flush() noexcept
+{
+    forEachSite([](LogSite &site) { internal::_logSiteSummary(site); });
 
-// std::format support for ProString
-template <>
-struct std::formatter<zlog::internal::ProString> {
-    constexpr auto parse(std::format_parse_context &ctx) { return ctx.begin(); }
+    if constexpr (config::ENABLE_BINARY_LOG) internal::BinaryLogger::instance().flushAll();
 
-    auto format(const zlog::internal::ProString &ps, std::format_context &ctx) const
-    {
-        return std::format_to(ctx.out(), "{}", ps.TEXT);
-    }
-};
+    if constexpr (config::ENABLE_ASYNC) internal::AsyncLogger::instance().flush();
+    else internal::SinkRegistry::instance().flush();
+}
+
+namespace internal {
+
+// Lets `config::killProcess()` flush pending logs before aborting
+inline const bool s_flush_hook_set = (config::s_flush_hook = [] () noexcept { flush(); }, true);
+
+} // namespace internal
+
+} // namespace zlog
 
 /// MACROS:
 
 // Raw output with color reset
-#define ZOUT  std::cout << "\n" << ::zlog::config::COLOR_RESET
-
-// Standard logging
-#define   ZDBG(...)  do { ::zlog::dbg  ({__VA_ARGS__}); } while (0)
-#define  ZINFO(...)  do { ::zlog::info ({__VA_ARGS__}); } while (0)
-#define  ZWARN(...)  do { ::zlog::warn ({__VA_ARGS__}); } while (0)
-#define   ZERR(...)  do { ::zlog::err  ({__VA_ARGS__}); } while (0)
-#define ZFATAL(...)  do { ::zlog::fatal({__VA_ARGS__}); } while (0)
+#define ZOUT  std::cout << "\n" << ::zlog::internal::colorReset()
+
+// Logs only if `LVL` is enabled (filtered levels format nothing, unless kept by the flight
+// recorder) and the call site is enabled and within `LIMIT`, binary logging records the
+// site and raw arguments instead
+#define _ZLOG(LVL, TAG, LIMIT, ...) do {                                  \
+    if constexpr (!::zlog::internal::isEnabled(LVL))                      \
+    {                                                                     \
+        if constexpr (::zlog::internal::FlightRecorder::KEEPS_FILTERED)   \
+            ::zlog::internal::flightRecord(LVL, {__VA_ARGS__});           \
+    }                                                                     \
+    else                                                                  \
+    {                                                                     \
+        static constinit ::zlog::LogSite _zlog_site {                     \
+            LVL, _ZSL, ::zlog::internal::siteFormat(#__VA_ARGS__), TAG,   \
+            LIMIT                                                         \
+        };                                                                \
+        if (!::zlog::internal::hitSite(_zlog_site)) {}                    \
+        else if constexpr (::zlog::config::ENABLE_BINARY_LOG)             \
+            ::zlog::internal::binaryLog(_zlog_site, __VA_ARGS__);         \
+        else ::zlog::internal::_log(_zlog_site, {__VA_ARGS__});           \
+    }                                                                     \
+} while (0)
+
+// Standard logging (limited by `config::RATE_LIMIT_PER_SEC`)
+#define   ZDBG(...)  _ZLOG(::zlog::LogLevel::Debug,   "ZDBG", ::zlog::RateLimit{}, __VA_ARGS__)
+#define  ZINFO(...)  _ZLOG(::zlog::LogLevel::Info ,  "ZINFO", ::zlog::RateLimit{}, __VA_ARGS__)
+#define  ZWARN(...)  _ZLOG(::zlog::LogLevel::Warn ,  "ZWARN", ::zlog::RateLimit{}, __VA_ARGS__)
+#define   ZERR(...)  _ZLOG(::zlog::LogLevel::Error,   "ZERR", ::zlog::RateLimit{}, __VA_ARGS__)
+#define ZFATAL(...)  _ZLOG(::zlog::LogLevel::Fatal, "ZFATAL", ::zlog::NO_LIMIT   , __VA_ARGS__)
+
+// Rate limited logging, at most `PER_SEC` lines per second (bursts of `PER_SEC`)
+#define   ZDBG_RATE(PER_SEC, ...)  _ZLOG(::zlog::LogLevel::Debug,   "ZDBG", (::zlog::RateLimit{PER_SEC, PER_SEC, 0, 0}), __VA_ARGS__)
+#define  ZINFO_RATE(PER_SEC, ...)  _ZLOG(::zlog::LogLevel::Info ,  "ZINFO", (::zlog::RateLimit{PER_SEC, PER_SEC, 0, 0}), __VA_ARGS__)
+#define  ZWARN_RATE(PER_SEC, ...)  _ZLOG(::zlog::LogLevel::Warn ,  "ZWARN", (::zlog::RateLimit{PER_SEC, PER_SEC, 0, 0}), __VA_ARGS__)
+#define   ZERR_RATE(PER_SEC, ...)  _ZLOG(::zlog::LogLevel::Error,   "ZERR", (::zlog::RateLimit{PER_SEC, PER_SEC, 0, 0}), __VA_ARGS__)
+
+// Logs the first `N` hits, then every `M`th (never again if `M` is 0)
+#define   ZDBG_EVERY(N, M, ...)  _ZLOG(::zlog::LogLevel::Debug,   "ZDBG", (::zlog::RateLimit{0, 0, N, M}), __VA_ARGS__)
+#define  ZINFO_EVERY(N, M, ...)  _ZLOG(::zlog::LogLevel::Info ,  "ZINFO", (::zlog::RateLimit{0, 0, N, M}), __VA_ARGS__)
+#define  ZWARN_EVERY(N, M, ...)  _ZLOG(::zlog::LogLevel::Warn ,  "ZWARN", (::zlog::RateLimit{0, 0, N, M}), __VA_ARGS__)
+#define   ZERR_EVERY(N, M, ...)  _ZLOG(::zlog::LogLevel::Error,   "ZERR", (::zlog::RateLimit{0, 0, N, M}), __VA_ARGS__)
+
+// Sampled logging, each hit is logged with probability `RATE` (0..1), decided before
+// the call site is counted or anything is formatted
+#define _ZLOG_SAMPLED(RATE, LVL, TAG, ...) do {                              \
+    if constexpr (!::zlog::internal::isEnabled(LVL)) {}                      \
+    else if (::zlog::internal::sampled(RATE))                                \
+        _ZLOG(LVL, TAG, ::zlog::RateLimit{}, __VA_ARGS__);                   \
+} while (0)
+
+#define   ZDBG_SAMPLED(RATE, ...)  _ZLOG_SAMPLED(RATE, ::zlog::LogLevel::Debug,   "ZDBG", __VA_ARGS__)
+#define  ZINFO_SAMPLED(RATE, ...)  _ZLOG_SAMPLED(RATE, ::zlog::LogLevel::Info ,  "ZINFO", __VA_ARGS__)
+#define  ZWARN_SAMPLED(RATE, ...)  _ZLOG_SAMPLED(RATE, ::zlog::LogLevel::Warn ,  "ZWARN", __VA_ARGS__)
+#define   ZERR_SAMPLED(RATE, ...)  _ZLOG_SAMPLED(RATE, ::zlog::LogLevel::Error,   "ZERR", __VA_ARGS__)
 
 // Conditional logging
 #define   ZDBG_IF(COND, ...)  do { if (COND)   ZDBG(__VA_ARGS__); } while (0)
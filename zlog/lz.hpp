@@ -0,0 +1,268 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+
+namespace zlog {
+
+namespace lz {
+
+// Layout of a compressed log (native byte order), a plain concatenation of blocks so a file
+// can be appended to and read back up to its last complete block after a crash:
+//
+//   file     := { block }
+//   block    := u32:MAGIC u32:raw_len u32:stored_len u32:checksum payload
+//   payload  := raw bytes if stored_len == raw_len, else { sequence }
+//   sequence := u8:token [ext] literals [ u16:offset [ext] ]  (the last one has no match)
+//
+// A token holds the literal count (high nibble) and the match length - 4 (low nibble), a
+// nibble of 15 is continued by bytes of 255 up to the first smaller one. Matches copy from
+// `offset` bytes back in the output and may overlap it. The checksum is FNV-1a of the raw bytes.
+
+static constexpr uint32_t MAGIC       = 0x315A4C5A;  //< "ZLZ1"
+static constexpr size_t   HEADER_SIZE = 16;
+
+static constexpr size_t MIN_MATCH     = 4;
+static constexpr size_t LAST_LITERALS = 5;      //< Blocks end with at least this many literals
+static constexpr size_t MAX_OFFSET    = 65535;
+static constexpr int    HASH_BITS     = 13;
+
+// Result of reading one block
+enum class BlockStatus : uint8_t {
+    Ok,
+    End,        //< No bytes left
+    Truncated,  //< Block cut short (the writer stopped mid-block)
+    Corrupt,    //< Bad magic, payload or checksum
+};
+
+// FNV-1a of `data`
+[[nodiscard]]
+inline uint32_t checksum(std::string_view data) noexcept
+{
+    uint32_t hash = 2166136261u;
+    for (const char ch : data) hash = (hash ^ static_cast<uint8_t>(ch)) * 16777619u;
+    return hash;
+}
+
+namespace internal {
+
+[[nodiscard]]
+inline uint32_t _load32(const char *ptr) noexcept
+{
+    uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+inline void _putU32(std::string &out, uint32_t value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Nibble continuation bytes of a length of 15 or more
+inline void _putLength(std::string &out, size_t len)
+{
+    for (; len >= 255; len -= 255) out += static_cast<char>(255);
+    out += static_cast<char>(len);
+}
+
+// One sequence: `literals`, then a match of `match_len` bytes `offset` back (none if 0)
+inline void _putSequence(std::string &out, std::string_view literals, size_t offset, size_t match_len)
+{
+    const size_t lit = literals.size();
+    const size_t len = match_len ? match_len - MIN_MATCH : 0;
+
+    out += static_cast<char>((std::min<size_t>(lit, 15) << 4) | std::min<size_t>(len, 15));
+    if (lit >= 15) _putLength(out, lit - 15);
+    out += literals;
+
+    if (match_len == 0) return;
+
+    out += static_cast<char>(offset & 0xFF);
+    out += static_cast<char>(offset >> 8);
+    if (len >= 15) _putLength(out, len - 15);
+}
+
+// Reads a nibble continuation into `len`, false past the end of `src`
+[[nodiscard]]
+inline bool _getLength(std::string_view src, size_t &pos, size_t &len) noexcept
+{
+    uint8_t byte;
+
+    do
+    {
+        if (pos >= src.size()) return false;
+        byte = static_cast<uint8_t>(src[pos++]);
+        len += byte;
+    }
+    while (byte == 255);
+
+    return true;
+}
+
+} // namespace internal
+
+// Appends the sequences of `src` to `out`: greedy matching over a hash of 4-byte prefixes,
+// skipping ahead faster through incompressible data
+inline void compress(std::string_view src, std::string &out)
+{
+    const char  *base   = src.data();
+    const size_t size   = src.size();
+    size_t       anchor = 0;
+
+    if (size > MIN_MATCH + LAST_LITERALS)
+    {
+        uint32_t table[size_t{1} << HASH_BITS] {};  //< Last position of each prefix hash
+
+        const size_t match_limit = size - LAST_LITERALS;        //< Matches end before this
+        const size_t start_limit = match_limit - MIN_MATCH;     //< and start at or before this
+        size_t       pos         = 1;
+        size_t       misses      = 0;
+
+        while (pos <= start_limit)
+        {
+            const uint32_t prefix = internal::_load32(base + pos);
+            const uint32_t hash   = (prefix * 2654435761u) >> (32 - HASH_BITS);
+            size_t         cand   = table[hash];
+            table[hash] = static_cast<uint32_t>(pos);
+
+            if (pos - cand > MAX_OFFSET || internal::_load32(base + cand) != prefix)
+            {
+                pos += 1 + (misses++ >> 6);
+                continue;
+            }
+
+            misses = 0;
+
+            while (pos > anchor && cand > 0 && base[pos - 1] == base[cand - 1]) --pos, --cand;
+
+            size_t len = MIN_MATCH;
+            while (pos + len < match_limit && base[pos + len] == base[cand + len]) ++len;
+
+            internal::_putSequence(out, src.substr(anchor, pos - anchor), pos - cand, len);
+            pos += len;
+            anchor = pos;
+        }
+    }
+
+    internal::_putSequence(out, src.substr(anchor), 0, 0);
+}
+
+// Decodes the sequences of `src` into `out` (resized to `raw_len`), false if they are malformed
+[[nodiscard]]
+inline bool decompress(std::string_view src, size_t raw_len, std::string &out)
+{
+    // A sequence byte expands to at most 255 bytes, larger claims come from a damaged header
+    if (raw_len > src.size() * 255 + 16) return false;
+
+    out.resize(raw_len);
+    char  *dst = out.data();
+    size_t pos = 0;
+    size_t len = 0;  //< Bytes decoded
+
+    while (pos < src.size())
+    {
+        const uint8_t token = static_cast<uint8_t>(src[pos++]);
+
+        size_t lit = token >> 4;
+        if (lit == 15 && !internal::_getLength(src, pos, lit)) return false;
+        if (lit > src.size() - pos || lit > raw_len - len) return false;
+
+        std::memcpy(dst + len, src.data() + pos, lit);
+        pos += lit;
+        len += lit;
+
+        if (pos == src.size()) break;  // Last sequence
+        if (src.size() - pos < 2) return false;
+
+        const size_t offset = static_cast<uint8_t>(src[pos]) | (static_cast<size_t>(static_cast<uint8_t>(src[pos + 1])) << 8);
+        pos += 2;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && !internal::_getLength(src, pos, match_len)) return false;
+        match_len += MIN_MATCH;
+
+        if (offset == 0 || offset > len || match_len > raw_len - len) return false;
+
+        // Byte by byte, the match may overlap the bytes it produces
+        for (const char *from = dst + len - offset; match_len > 0; --match_len) dst[len++] = *from++;
+    }
+
+    return len == raw_len;
+}
+
+// Appends `raw` as one block, stored uncompressed if compressing does not make it smaller
+inline void putBlock(std::string &out, std::string_view raw)
+{
+    const size_t header = out.size();
+    out.resize(header + HEADER_SIZE);
+    compress(raw, out);
+
+    size_t stored = out.size() - header - HEADER_SIZE;
+
+    if (stored >= raw.size())
+    {
+        out.resize(header + HEADER_SIZE);
+        out += raw;
+        stored = raw.size();
+    }
+
+    const uint32_t fields[4] = {
+        MAGIC, static_cast<uint32_t>(raw.size()), static_cast<uint32_t>(stored), checksum(raw)
+    };
+    std::memcpy(out.data() + header, fields, HEADER_SIZE);
+}
+
+// Reads the block at the start of `in` into `raw` and removes it from `in`
+// (`in` is left unchanged unless the status is `Ok`)
+[[nodiscard]]
+inline BlockStatus getBlock(std::string_view &in, std::string &raw)
+{
+    if (in.empty()) return BlockStatus::End;
+    if (in.size() < HEADER_SIZE) return BlockStatus::Truncated;
+
+    uint32_t fields[4];
+    std::memcpy(fields, in.data(), HEADER_SIZE);
+
+    const auto [magic, raw_len, stored, sum] = fields;
+    if (magic != MAGIC || stored > raw_len) return BlockStatus::Corrupt;
+    if (in.size() - HEADER_SIZE < stored) return BlockStatus::Truncated;
+
+    const std::string_view payload = in.substr(HEADER_SIZE, stored);
+
+    if (stored == raw_len) raw.assign(payload);
+    else if (!decompress(payload, raw_len, raw)) return BlockStatus::Corrupt;
+
+    if (checksum(raw) != sum) return BlockStatus::Corrupt;
+
+    in.remove_prefix(HEADER_SIZE + stored);
+    return BlockStatus::Ok;
+}
+
+// Offset of the first valid block of `in` at or after `from` (npos if none), to resume
+// reading after a damaged region
+[[nodiscard]]
+inline size_t findBlock(std::string_view in, size_t from)
+{
+    char magic[sizeof(MAGIC)];
+    std::memcpy(magic, &MAGIC, sizeof(MAGIC));
+
+    std::string raw {};
+
+    for (size_t pos = in.find({magic, sizeof(magic)}, from); pos != std::string_view::npos;
+         pos = in.find({magic, sizeof(magic)}, pos + 1))
+    {
+        std::string_view rest = in.substr(pos);
+        if (getBlock(rest, raw) == BlockStatus::Ok) return pos;
+    }
+
+    return std::string_view::npos;
+}
+
+} // namespace lz
+
+} // namespace zlog
@@ -0,0 +1,442 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./kv.hpp"
+#include "./log.hpp"
+#include "./profiler.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <string_view>
+
+namespace zlog {
+
+enum class MetricKind : uint8_t {
+    Counter,    //< Sum of the added amounts, reported with its change over the interval
+    Gauge,      //< Last value set
+    Histogram,  //< Distribution of the recorded values over the interval
+};
+
+// One named metric, shared by every `ZCOUNT`, `ZGAUGE` or `ZHIST` of its name
+struct Metric {
+    const MetricKind       KIND;
+    const std::string_view NAME;
+
+    std::atomic<uint32_t> id      {0};      //< Slot in the per-thread shards, 0 until first use
+    std::atomic<int64_t>  value   {0};      //< Last value of a gauge
+    std::atomic<bool>     changed {false};  //< Gauge set since the last report
+
+    consteval Metric(MetricKind kind, std::string_view name) noexcept
+        : KIND{kind}
+        , NAME{name}
+    {}
+
+    void add(uint64_t n) noexcept;         //< Counters
+    void set(int64_t value) noexcept;      //< Gauges
+    void record(uint64_t value) noexcept;  //< Histograms
+};
+
+namespace internal {
+
+// Metric name as a template argument
+template <size_t N>
+struct MetricName {
+    char text[N] {};
+
+    consteval MetricName(const char (&name)[N]) noexcept
+    {
+        for (size_t i = 0; i < N; ++i) text[i] = name[i];
+    }
+
+    [[nodiscard]]
+    constexpr std::string_view view() const noexcept { return {text, N - 1}; }
+};
+
+// The one `Metric` of each name and kind
+template <MetricName NAME> inline constinit Metric s_counter   {MetricKind::Counter  , NAME.view()};
+template <MetricName NAME> inline constinit Metric s_gauge     {MetricKind::Gauge    , NAME.view()};
+template <MetricName NAME> inline constinit Metric s_histogram {MetricKind::Histogram, NAME.view()};
+
+// Aggregates metrics in per-thread shards (single writer, no locked instructions on the hot
+// path), merged by a reporter that logs one line per `config::METRICS_INTERVAL_MS`
+class MetricRegistry final {
+    static constexpr size_t CHUNK  = 8;  //< Counters per cache line
+    static constexpr size_t CHUNKS = (config::METRICS_MAX + CHUNK - 1) / CHUNK;
+
+    static constexpr uint32_t FULL = UINT32_MAX;  //< Id of metrics refused by `_register`
+
+    // One cache line of a thread's counters, threads never write the same line
+    struct alignas(64) CounterChunk {
+        std::atomic<uint64_t> values[CHUNK] {};
+    };
+
+    // One thread's histogram of one metric
+    struct alignas(64) HistogramShard {
+        ScopeStats stats {};
+    };
+
+    // Per-thread shards, indexed by metric id - 1
+    struct ThreadShards {
+        std::atomic<CounterChunk *>   counters[CHUNKS]                {};
+        std::atomic<HistogramShard *> histograms[config::METRICS_MAX] {};
+
+        ThreadShards()
+        {
+            instance()._attach(this);
+        }
+
+        ~ThreadShards()
+        {
+            instance()._detach(this);
+        }
+    };
+
+    // Counter and histogram values merged over threads, by id - 1
+    struct Totals {
+        std::vector<uint64_t>     counts     {};
+        std::vector<ScopeSummary> histograms {};
+    };
+
+    std::mutex                  mutex      {};  //< Guards everything below
+    std::vector<Metric *>       counters   {};
+    std::vector<Metric *>       gauges     {};
+    std::vector<Metric *>       histograms {};
+    std::vector<ThreadShards *> threads    {};
+    Totals                      retired    {};  //< Shards of exited threads
+    Totals                      reported   {};  //< Totals at the last report
+
+    inline static thread_local bool s_destroyed = false;
+
+    MetricRegistry()
+    {
+        if constexpr (config::METRICS_INTERVAL_MS > 0)
+            std::thread{[this] { _run(); }}.detach();
+    }
+
+    [[noreturn]]
+    void _run()
+    {
+        while (true)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{config::METRICS_INTERVAL_MS});
+            report();
+        }
+    }
+
+    void _attach(ThreadShards *local)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        threads.push_back(local);
+    }
+
+    void _detach(ThreadShards *local) noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        _mergeInto(retired, *local);
+
+        for (std::atomic<CounterChunk *> &chunk : local->counters)
+            delete chunk.exchange(nullptr, std::memory_order_acq_rel);
+
+        for (std::atomic<HistogramShard *> &shard : local->histograms)
+            delete shard.exchange(nullptr, std::memory_order_acq_rel);
+
+        std::erase(threads, local);
+        s_destroyed = true;
+    }
+
+    // Calling thread's shards, nullptr once destroyed at thread exit
+    [[nodiscard]]
+    static ThreadShards *_local() noexcept
+    {
+        if (s_destroyed) return nullptr;
+
+        thread_local ThreadShards s_shards {};
+        return &s_shards;
+    }
+
+    // Add a thread's shards to `out` (caller holds `mutex`)
+    void _mergeInto(Totals &out, const ThreadShards &local) const
+    {
+        out.counts.resize(std::min(counters.size(), config::METRICS_MAX));
+        out.histograms.resize(std::min(histograms.size(), config::METRICS_MAX));
+
+        for (size_t i = 0; i < out.counts.size(); ++i)
+            if (const CounterChunk *chunk = local.counters[i / CHUNK].load(std::memory_order_acquire))
+                out.counts[i] += chunk->values[i % CHUNK].load(std::memory_order_relaxed);
+
+        for (size_t i = 0; i < out.histograms.size(); ++i)
+            if (const HistogramShard *shard = local.histograms[i].load(std::memory_order_acquire))
+                out.histograms[i].merge(shard->stats);
+    }
+
+    // Assign a slot to `metric` among those of its kind, returns its id (`FULL` once
+    // `config::METRICS_MAX` metrics of the kind exist)
+    uint32_t _register(Metric &metric) noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        if (const uint32_t id = metric.id.load(std::memory_order_relaxed)) return id;
+
+        std::vector<Metric *> &kind = (metric.KIND == MetricKind::Counter) ? counters
+                                    : (metric.KIND == MetricKind::Gauge)   ? gauges
+                                    :                                        histograms;
+
+        if (kind.size() >= config::METRICS_MAX)
+        {
+            metric.id.store(FULL, std::memory_order_release);
+            return FULL;
+        }
+
+        kind.push_back(&metric);
+
+        const auto id = static_cast<uint32_t>(kind.size());
+        metric.id.store(id, std::memory_order_release);
+        return id;
+    }
+
+    // Slot index of `metric`, `METRICS_MAX` if it does not fit
+    [[nodiscard]]
+    size_t _index(Metric &metric) noexcept
+    {
+        uint32_t id = metric.id.load(std::memory_order_acquire);
+        if (!id) id = _register(metric);
+        return std::min<size_t>(id - 1, config::METRICS_MAX);
+    }
+
+    // Values recorded between the `before` and `now` totals of a histogram
+    [[nodiscard]]
+    static ScopeSummary _since(const ScopeSummary &now, const ScopeSummary &before) noexcept
+    {
+        ScopeSummary out {};
+        out.count = now.count - before.count;
+        out.total = now.total - before.total;
+
+        size_t first = out.buckets.size(), last = 0;
+
+        for (size_t i = 0; i < out.buckets.size(); ++i)
+        {
+            out.buckets[i] = now.buckets[i] - before.buckets[i];
+            if (out.buckets[i] == 0) continue;
+
+            first = std::min(first, i);
+            last  = i;
+        }
+
+        if (out.count == 0) return out;
+
+        // Bucket bounds, within the lifetime extremes
+        out.min = std::max(first > 0 ? LatencyBuckets::upperOf(first - 1) + 1 : 0, now.min);
+        out.max = std::min(LatencyBuckets::upperOf(last), now.max);
+        return out;
+    }
+
+public:
+    MetricRegistry(const MetricRegistry&) = delete;
+    MetricRegistry &operator=(const MetricRegistry&) = delete;
+
+    // Process-wide registry, never destroyed so it outlives thread exit
+    [[nodiscard]]
+    static MetricRegistry &instance() noexcept
+    {
+        static MetricRegistry *s_registry = [] {
+            MetricRegistry *registry = new MetricRegistry{};
+
+            if constexpr (config::METRICS_REPORT_AT_EXIT)
+                std::atexit([] { instance().report(); });
+
+            return registry;
+        }();
+
+        return *s_registry;
+    }
+
+    void count(Metric &metric, uint64_t n) noexcept
+    {
+        const size_t index = _index(metric);
+        if (index >= config::METRICS_MAX) return;
+
+        ThreadShards *local = _local();
+        if (!local) return;
+
+        std::atomic<CounterChunk *> &slot = local->counters[index / CHUNK];
+
+        CounterChunk *chunk = slot.load(std::memory_order_relaxed);
+        if (!chunk)
+        {
+            chunk = new CounterChunk{};
+            slot.store(chunk, std::memory_order_release);
+        }
+
+        std::atomic<uint64_t> &value = chunk->values[index % CHUNK];
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void set(Metric &metric, int64_t value) noexcept
+    {
+        if (_index(metric) >= config::METRICS_MAX) return;
+
+        metric.value.store(value, std::memory_order_relaxed);
+        metric.changed.store(true, std::memory_order_release);
+    }
+
+    void record(Metric &metric, uint64_t value) noexcept
+    {
+        const size_t index = _index(metric);
+        if (index >= config::METRICS_MAX) return;
+
+        ThreadShards *local = _local();
+        if (!local) return;
+
+        std::atomic<HistogramShard *> &slot = local->histograms[index];
+
+        HistogramShard *shard = slot.load(std::memory_order_relaxed);
+        if (!shard)
+        {
+            shard = new HistogramShard{};
+            slot.store(shard, std::memory_order_release);
+        }
+
+        shard->stats.add(value);
+    }
+
+    // Log one line with the metrics changed since the last report, nothing if none did:
+    // "[METR] : requests=+56 (1234) depth=17 latency{n=100 avg=12 p50=10 p99=40 max=52}"
+    // (or a structured record with `config::METRICS_STRUCTURED`)
+    void report()
+    {
+        std::string line {};
+        std::shared_ptr<const KvEncoder> encoder {};
+        bool any = false;
+
+        if constexpr (config::METRICS_STRUCTURED)
+        {
+            encoder = kvEncoder().load(std::memory_order_acquire);
+            encoder->begin(line, LogLevel::Info, "metrics");
+        }
+        else
+        {
+            line += view(config::rendered::METRICS_TAG);
+            line += config::TAG_TAG.substr(0, 2);  // Fields follow with their own space
+        }
+
+        // `name=value` as text or a structured field
+        const auto put = [&](std::string_view name, std::string_view suffix, auto value, std::string_view text) {
+            any = true;
+
+            if constexpr (config::METRICS_STRUCTURED)
+                _kvField(*encoder, line, std::string{name} + std::string{suffix}, value);
+            else
+                std::format_to(std::back_inserter(line), " {}{}", name, text);
+        };
+
+        {
+            std::scoped_lock<std::mutex> lock {mutex};
+
+            Totals now = retired;
+            for (const ThreadShards *local : threads) _mergeInto(now, *local);
+
+            reported.counts.resize(now.counts.size());
+            reported.histograms.resize(now.histograms.size());
+
+            for (size_t i = 0; i < now.counts.size(); ++i)
+            {
+                const uint64_t delta = now.counts[i] - reported.counts[i];
+                if (delta > 0) put(counters[i]->NAME, "", delta, std::format("=+{} ({})", delta, now.counts[i]));
+            }
+
+            for (Metric *gauge : gauges)
+            {
+                if (!gauge->changed.exchange(false, std::memory_order_acquire)) continue;
+
+                const int64_t value = gauge->value.load(std::memory_order_relaxed);
+                put(gauge->NAME, "", value, std::format("={}", value));
+            }
+
+            for (size_t i = 0; i < now.histograms.size(); ++i)
+            {
+                const ScopeSummary interval = _since(now.histograms[i], reported.histograms[i]);
+                if (interval.count == 0) continue;
+
+                const std::string_view name = histograms[i]->NAME;
+                const uint64_t p50 = interval.percentile(0.50);
+                const uint64_t p99 = interval.percentile(0.99);
+
+                if constexpr (config::METRICS_STRUCTURED)
+                {
+                    put(name, ".count", interval.count, {});
+                    put(name, ".p50"  , p50           , {});
+                    put(name, ".p99"  , p99           , {});
+                    put(name, ".max"  , interval.max  , {});
+                }
+                else put(name, "", interval.count, std::format(
+                    "{{n={} avg={} p50={} p99={} max={}}}",
+                    interval.count, interval.total / interval.count, p50, p99, interval.max
+                ));
+            }
+
+            reported = std::move(now);
+        }
+
+        if (!any || !isEnabled(LogLevel::Info)) return;
+
+        if constexpr (config::METRICS_STRUCTURED) encoder->end(line);
+        else line += '\n';
+
+        const std::string_view text = std::string_view{line}.substr(0, line.size() - 1);
+
+        if constexpr (config::ENABLE_BINARY_LOG) binaryLogText(LogLevel::Info, text);
+        else if constexpr (config::METRICS_STRUCTURED) _writeLine(LogLevel::Info, line);
+        else
+        {
+            // Not through `_log`, its thread-local line is already destroyed when reporting at exit
+            std::string rendered {};
+            _renderLine(rendered, LogLevel::Info, ProString{text}, {});
+            _writeLine(LogLevel::Info, rendered);
+        }
+    }
+};
+
+} // namespace internal
+
+inline void Metric::add(uint64_t n) noexcept
+{
+    internal::MetricRegistry::instance().count(*this, n);
+}
+
+inline void Metric::set(int64_t value) noexcept
+{
+    internal::MetricRegistry::instance().set(*this, value);
+}
+
+inline void Metric::record(uint64_t value) noexcept
+{
+    internal::MetricRegistry::instance().record(*this, value);
+}
+
+// Log the metrics changed since the last report now (also done every `config::METRICS_INTERVAL_MS`)
+inline void reportMetrics()
+{
+    internal::MetricRegistry::instance().report();
+}
+
+} // namespace zlog
+
+/// MACROS:
+
+// Add `N` to counter `NAME` (the calling thread's shard, no locked instruction)
+#define ZCOUNT(NAME, N)  do { ::zlog::internal::s_counter<#NAME>.add(static_cast<uint64_t>(N)); } while (0)
+
+// Set gauge `NAME` to `V`
+#define ZGAUGE(NAME, V)  do { ::zlog::internal::s_gauge<#NAME>.set(static_cast<int64_t>(V)); } while (0)
+
+// Record the non-negative value `V` in histogram `NAME` (log-bucketed, <= 12.5% error)
+#define  ZHIST(NAME, V)  do { ::zlog::internal::s_histogram<#NAME>.record(static_cast<uint64_t>(V)); } while (0)
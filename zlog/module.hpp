@@ -0,0 +1,329 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./log.hpp"
+#include "./site.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
+
+namespace zlog {
+
+// Named logging category with a level adjustable at runtime (above the compile-time floor)
+struct LogModule {
+    static constexpr uint8_t OFF   = static_cast<uint8_t>(LogLevel::Fatal) + 1;  //< Level that filters everything
+    static constexpr uint8_t UNSET = UINT8_MAX;                                  //< Not yet registered
+
+    const std::string_view TAG;   //< "[name]"
+    const std::string_view NAME;
+
+    std::atomic<uint8_t> level {UNSET};
+
+    consteval explicit LogModule(std::string_view tag) noexcept
+        : TAG{tag}
+        , NAME{tag.substr(1, tag.size() - 2)}
+    {}
+
+    // True if `lvl` passes the runtime level (a single relaxed load once registered)
+    [[nodiscard]]
+    bool allows(LogLevel lvl) noexcept;
+};
+
+namespace internal {
+
+// Module name as a template argument, stored as its "[name]" tag
+template <size_t N>
+struct ModuleName {
+    char tag[N + 1] {};
+
+    consteval ModuleName(const char (&name)[N]) noexcept
+    {
+        tag[0] = '[';
+        for (size_t i = 0; i + 1 < N; ++i) tag[i + 1] = name[i];
+        tag[N] = ']';
+    }
+
+    [[nodiscard]]
+    constexpr std::string_view view() const noexcept { return {tag, N + 1}; }
+};
+
+// The one `LogModule` of each name
+template <ModuleName NAME>
+inline constinit LogModule s_module {NAME.view()};
+
+// Parses "trace", "debug", "info", "warn", "error", "fatal" or "off"
+[[nodiscard]]
+inline std::optional<uint8_t> parseLevel(std::string_view text) noexcept
+{
+    static constexpr std::string_view NAMES[] = {"trace", "debug", "info", "warn", "error", "fatal", "off"};
+
+    std::string lower {text};
+    std::ranges::transform(lower, lower.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+
+    for (size_t i = 0; i < std::size(NAMES); ++i)
+        if (lower == NAMES[i]) return static_cast<uint8_t>(i);
+
+    return std::nullopt;
+}
+
+// Every module with its configured level, fed by the API, `ZLOG_LEVELS` and `config::MODULE_LEVELS_FILE`
+class ModuleRegistry final {
+    std::mutex                                   mutex    {};
+    std::vector<LogModule *>                     modules  {};
+    std::vector<std::pair<std::string, uint8_t>> levels   {};  //< Per-name levels, also for modules not yet used
+    uint8_t                                      fallback {static_cast<uint8_t>(config::MIN_LEVEL)};  //< Level of other modules
+
+    ModuleRegistry()
+    {
+        _reload(nullptr);
+
+        if constexpr (std::string_view{config::MODULE_LEVELS_FILE}.size() > 0)
+        {
+            _reload(config::MODULE_LEVELS_FILE);
+            std::thread{[this] { _watch(config::MODULE_LEVELS_FILE); }}.detach();
+        }
+    }
+
+    // Configured level of `name` (caller holds `mutex`)
+    [[nodiscard]]
+    uint8_t _levelOf(std::string_view name) const noexcept
+    {
+        for (const auto &[module_name, level] : levels)
+            if (module_name == name) return level;
+
+        return fallback;
+    }
+
+    // Set the level of `name`, "*" sets `fallback` (caller holds `mutex`)
+    void _set(std::string_view name, uint8_t level)
+    {
+        if (name == "*")
+        {
+            fallback = level;
+            return;
+        }
+
+        const auto it = std::ranges::find(levels, name, [](const auto &entry) { return std::string_view{entry.first}; });
+        if (it != levels.end()) it->second = level;
+        else levels.emplace_back(name, level);
+    }
+
+    // Store the configured level into every attached module (caller holds `mutex`)
+    void _storeLevels() noexcept
+    {
+        for (LogModule *module : modules) module->level.store(_levelOf(module->NAME), std::memory_order_relaxed);
+    }
+
+    // `apply` without locking or storing (caller holds `mutex`)
+    bool _applyLocked(std::string_view spec)
+    {
+        bool ok = true;
+
+        while (!spec.empty())
+        {
+            const size_t end = spec.find_first_of(", \t\r\n#");
+            const std::string_view entry = spec.substr(0, end);
+
+            if (end == std::string_view::npos) spec = {};
+            else if (spec[end] == '#')
+            {
+                const size_t line_end = spec.find('\n', end);
+                spec = (line_end == std::string_view::npos) ? std::string_view{} : spec.substr(line_end + 1);
+            }
+            else spec.remove_prefix(end + 1);
+
+            if (entry.empty()) continue;
+
+            const size_t eq = entry.find('=');
+            const auto level = (eq == std::string_view::npos) ? std::nullopt : parseLevel(entry.substr(eq + 1));
+
+            if (eq == 0 || !level)
+            {
+                ok = false;
+                continue;
+            }
+
+            _set(entry.substr(0, eq), *level);
+        }
+
+        return ok;
+    }
+
+    // Rebuild every level from `ZLOG_LEVELS` then the contents of `path` (if not nullptr), so
+    // entries removed from the file stop applying; false if `path` cannot be read or is malformed
+    bool _reload(const char *path)
+    {
+        std::string text {};
+
+        if (path)
+        {
+            std::ifstream file {path};
+            if (!file) return false;
+
+            std::stringstream contents {};
+            contents << file.rdbuf();
+            text = std::move(contents).str();
+        }
+
+        std::scoped_lock<std::mutex> lock {mutex};
+
+        levels.clear();
+        fallback = static_cast<uint8_t>(config::MIN_LEVEL);
+
+        if (const char *env = std::getenv("ZLOG_LEVELS")) _applyLocked(env);
+        const bool ok = _applyLocked(text);
+
+        _storeLevels();
+        return ok;
+    }
+
+    // Poll `path` and reload it whenever its modification time changes
+    [[noreturn]]
+    void _watch(const char *path)
+    {
+        std::error_code error {};
+        auto last = std::filesystem::last_write_time(path, error);
+
+        while (true)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{config::MODULE_LEVELS_POLL_MS});
+
+            const auto now = std::filesystem::last_write_time(path, error);
+            if (error || now == last) continue;
+
+            last = now;
+            _reload(path);
+        }
+    }
+
+public:
+    ModuleRegistry(const ModuleRegistry&) = delete;
+    ModuleRegistry &operator=(const ModuleRegistry&) = delete;
+
+    // Process-wide registry, never destroyed so modules stay usable during static destruction
+    [[nodiscard]]
+    static ModuleRegistry &instance() noexcept
+    {
+        static ModuleRegistry *s_registry = new ModuleRegistry{};
+        return *s_registry;
+    }
+
+    // Register `module` with its configured level, returns that level
+    uint8_t attach(LogModule &module)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+
+        if (module.level.load(std::memory_order_relaxed) == LogModule::UNSET)
+        {
+            modules.push_back(&module);
+            module.level.store(_levelOf(module.NAME), std::memory_order_relaxed);
+        }
+
+        return module.level.load(std::memory_order_relaxed);
+    }
+
+    // Set the level of module `name` ("*" for every module without a level of its own)
+    void set(std::string_view name, uint8_t level)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        _set(name, level);
+        _storeLevels();
+    }
+
+    // Current level of module `name`
+    [[nodiscard]]
+    uint8_t get(std::string_view name)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        return _levelOf(name);
+    }
+
+    // Apply "name=level" entries separated by commas, spaces or new lines ('#' starts a comment),
+    // false if any entry is malformed (the others are still applied)
+    bool apply(std::string_view spec)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        const bool ok = _applyLocked(spec);
+        _storeLevels();
+        return ok;
+    }
+};
+
+} // namespace internal
+
+inline bool LogModule::allows(LogLevel lvl) noexcept
+{
+    const auto value = static_cast<uint8_t>(lvl);
+    const uint8_t min = level.load(std::memory_order_relaxed);
+
+    if (value >= min) [[likely]] return true;
+    if (min != UNSET) return false;
+
+    return value >= internal::ModuleRegistry::instance().attach(*this);
+}
+
+// Set the runtime level of module `name` ("*" for every module without a level of its own)
+inline void setModuleLevel(std::string_view name, LogLevel lvl)
+{
+    internal::ModuleRegistry::instance().set(name, static_cast<uint8_t>(lvl));
+}
+
+// Silence module `name` ("*" for every module without a level of its own)
+inline void disableModule(std::string_view name)
+{
+    internal::ModuleRegistry::instance().set(name, LogModule::OFF);
+}
+
+// Apply a level spec such as "net=debug,db=off,*=info", false if any entry is malformed
+inline bool setModuleLevels(std::string_view spec)
+{
+    return internal::ModuleRegistry::instance().apply(spec);
+}
+
+} // namespace zlog
+
+/// MACROS:
+
+// Logs through module `MOD` (created on first use), checked against its runtime level
+// before anything is formatted; the compile-time floor still removes filtered levels
+#define _ZLOG_M(MOD, LVL, MACRO, ...) do {                                   \
+    if constexpr (!::zlog::internal::isEnabled(LVL)) {}                      \
+    else if (!::zlog::internal::s_module<#MOD>.allows(LVL)) {}               \
+    else                                                                     \
+    {                                                                        \
+        static constinit ::zlog::LogSite _zlog_site {                        \
+            LVL, _ZSL, ::zlog::internal::siteFormat(#__VA_ARGS__), MACRO     \
+        };                                                                   \
+        if (!::zlog::internal::hitSite(_zlog_site)) {}                       \
+        else if constexpr (::zlog::config::ENABLE_BINARY_LOG)                \
+            ::zlog::internal::binaryLogModule(                               \
+                _zlog_site, ::zlog::internal::s_module<#MOD>.TAG,            \
+                __VA_ARGS__                                                  \
+            );                                                               \
+        else ::zlog::internal::_log(                                         \
+            _zlog_site, {__VA_ARGS__}, ::zlog::internal::s_module<#MOD>.TAG  \
+        );                                                                   \
+    }                                                                        \
+} while (0)
+
+// Module logging
+#define   ZDBG_M(MOD, ...)  _ZLOG_M(MOD, ::zlog::LogLevel::Debug,   "ZDBG", __VA_ARGS__)
+#define  ZINFO_M(MOD, ...)  _ZLOG_M(MOD, ::zlog::LogLevel::Info ,  "ZINFO", __VA_ARGS__)
+#define  ZWARN_M(MOD, ...)  _ZLOG_M(MOD, ::zlog::LogLevel::Warn ,  "ZWARN", __VA_ARGS__)
+#define   ZERR_M(MOD, ...)  _ZLOG_M(MOD, ::zlog::LogLevel::Error,   "ZERR", __VA_ARGS__)
+#define ZFATAL_M(MOD, ...)  _ZLOG_M(MOD, ::zlog::LogLevel::Fatal, "ZFATAL", __VA_ARGS__)
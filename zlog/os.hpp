@@ -0,0 +1,104 @@
+#pragma once
+
+#include "./config.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <climits>
+#include <cstddef>
+#include <algorithm>
+#include <string_view>
+
+namespace zlog {
+
+namespace internal {
+
+// File descriptors of the standard streams
+static constexpr int FD_OUT = 1;
+static constexpr int FD_ERR = 2;
+
+// Output descriptor for a log level (stdout for Trace/Debug/Info, stderr for Warn/Error/Fatal)
+[[nodiscard]]
+constexpr int fdFor(LogLevel level) noexcept
+{
+    return static_cast<int>(level) < static_cast<int>(LogLevel::Warn) ? FD_OUT : FD_ERR;
+}
+
+// Write all of `data` to `fd`, retrying on partial writes and interrupts (async-signal-safe)
+inline bool writeFdRaw(int fd, std::string_view data) noexcept
+{
+    while (!data.empty())
+    {
+#ifdef _WIN32
+        const int n = _write(fd, data.data(), static_cast<unsigned>(std::min<size_t>(data.size(), INT_MAX)));
+#else
+        const ssize_t n = ::write(fd, data.data(), data.size());
+#endif
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+
+    return true;
+}
+
+// Write all of `data` to `fd` after pending stdio output
+inline bool writeFd(int fd, std::string_view data) noexcept
+{
+    // Keep `ZOUT` text (buffered by stdio) ahead of raw writes
+    std::fflush(stdout);
+    return writeFdRaw(fd, data);
+}
+
+// Gather-write `count` buffers to `fd` with as few syscalls as possible
+inline bool writeFdv(int fd, const std::string_view *parts, size_t count) noexcept
+{
+#ifdef _WIN32
+    for (size_t i = 0; i < count; ++i)
+        if (!writeFd(fd, parts[i])) return false;
+    return true;
+#else
+    std::fflush(stdout);
+
+    static constexpr size_t MAX_IOV = IOV_MAX < 1024 ? IOV_MAX : 1024;
+    iovec iov[MAX_IOV];
+
+    while (count > 0)
+    {
+        const size_t n_iov = std::min(count, MAX_IOV);
+        size_t total = 0;
+
+        for (size_t i = 0; i < n_iov; ++i)
+        {
+            iov[i].iov_base = const_cast<char *>(parts[i].data());
+            iov[i].iov_len  = parts[i].size();
+            total += parts[i].size();
+        }
+
+        ssize_t n = ::writev(fd, iov, static_cast<int>(n_iov));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+
+        // Finish a short write part by part
+        if (static_cast<size_t>(n) < total)
+        {
+            size_t done = static_cast<size_t>(n);
+            for (size_t i = 0; i < n_iov; ++i)
+            {
+                if (done >= parts[i].size()) { done -= parts[i].size(); continue; }
+                if (!writeFd(fd, parts[i].substr(done))) return false;
+                done = 0;
+            }
+        }
+
+        parts += n_iov;
+        count -= n_iov;
+    }
+
+    return true;
+#endif
+}
+
+} // namespace internal
+
+} // namespace zlog
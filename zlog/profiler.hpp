@@ -0,0 +1,323 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./os.hpp"
+#include "./site.hpp"
+
+#include <array>
+#include <bit>
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
+#include <format>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <string_view>
+
+namespace zlog {
+
+namespace internal {
+
+// HDR style latency buckets: exact below 8ns, then 8 linear sub-buckets per power of two (<= 12.5% error)
+struct LatencyBuckets {
+    static constexpr size_t SUB_BITS = 3;
+    static constexpr size_t SUB      = size_t{1} << SUB_BITS;
+    static constexpr size_t COUNT    = (64 - SUB_BITS + 1) * SUB;
+
+    [[nodiscard]]
+    static constexpr size_t indexOf(uint64_t ns) noexcept
+    {
+        if (ns < SUB) return static_cast<size_t>(ns);
+
+        const size_t msb = static_cast<size_t>(std::bit_width(ns)) - 1;
+        return (msb - SUB_BITS + 1) * SUB + static_cast<size_t>((ns >> (msb - SUB_BITS)) & (SUB - 1));
+    }
+
+    // Largest value falling into bucket `index`
+    [[nodiscard]]
+    static constexpr uint64_t upperOf(size_t index) noexcept
+    {
+        if (index < SUB) return index;
+
+        const size_t   msb   = index / SUB + SUB_BITS - 1;
+        const uint64_t width = uint64_t{1} << (msb - SUB_BITS);
+        return ((SUB + index % SUB) << (msb - SUB_BITS)) + width - 1;
+    }
+};
+
+// Timings of one scope on one thread, only written by the owning thread
+struct ScopeStats {
+    std::atomic<uint64_t> count   {0};
+    std::atomic<uint64_t> total   {0};
+    std::atomic<uint64_t> min     {UINT64_MAX};
+    std::atomic<uint64_t> max     {0};
+    std::atomic<uint64_t> buckets[LatencyBuckets::COUNT] {};
+
+    // Single writer, so plain load/store pairs are enough (no locked instructions)
+    void add(uint64_t ns) noexcept
+    {
+        auto bump = [](std::atomic<uint64_t> &value, uint64_t by) {
+            value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+        };
+
+        bump(count, 1);
+        bump(total, ns);
+        bump(buckets[LatencyBuckets::indexOf(ns)], 1);
+        if (ns < min.load(std::memory_order_relaxed)) min.store(ns, std::memory_order_relaxed);
+        if (ns > max.load(std::memory_order_relaxed)) max.store(ns, std::memory_order_relaxed);
+    }
+};
+
+// Timings of one scope merged over threads
+struct ScopeSummary {
+    uint64_t count {0};
+    uint64_t total {0};
+    uint64_t min   {UINT64_MAX};
+    uint64_t max   {0};
+    std::array<uint64_t, LatencyBuckets::COUNT> buckets {};
+
+    void merge(const ScopeStats &stats) noexcept
+    {
+        count += stats.count.load(std::memory_order_relaxed);
+        total += stats.total.load(std::memory_order_relaxed);
+        min    = std::min(min, stats.min.load(std::memory_order_relaxed));
+        max    = std::max(max, stats.max.load(std::memory_order_relaxed));
+
+        for (size_t i = 0; i < buckets.size(); ++i)
+            buckets[i] += stats.buckets[i].load(std::memory_order_relaxed);
+    }
+
+    void merge(const ScopeSummary &other) noexcept
+    {
+        count += other.count;
+        total += other.total;
+        min    = std::min(min, other.min);
+        max    = std::max(max, other.max);
+
+        for (size_t i = 0; i < buckets.size(); ++i) buckets[i] += other.buckets[i];
+    }
+
+    // Approximate `q` quantile (0..1) in nanoseconds
+    [[nodiscard]]
+    uint64_t percentile(double q) const noexcept
+    {
+        if (count == 0) return 0;
+
+        const auto rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < buckets.size(); ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank) return std::clamp(LatencyBuckets::upperOf(i), min, max);
+        }
+
+        return max;
+    }
+};
+
+// "950ns", "12.3us", "4.5ms", "1.25s"
+[[nodiscard]]
+inline std::string formatDuration(uint64_t ns)
+{
+    if (ns < 1'000)         return std::format("{}ns", ns);
+    if (ns < 1'000'000)     return std::format("{:.1f}us", static_cast<double>(ns) / 1e3);
+    if (ns < 1'000'000'000) return std::format("{:.1f}ms", static_cast<double>(ns) / 1e6);
+    return std::format("{:.2f}s", static_cast<double>(ns) / 1e9);
+}
+
+// Aggregates scope timings in per-thread tables, merged on demand
+class Profiler final {
+    static constexpr size_t CHUNK  = 16;  //< Sites per lazily allocated block
+    static constexpr size_t CHUNKS = (config::PROFILER_MAX_SITES + CHUNK - 1) / CHUNK;
+
+    // Per-thread stats, indexed by site id - 1
+    struct ThreadStats {
+        std::atomic<ScopeStats *> chunks[CHUNKS] {};
+
+        ThreadStats()
+        {
+            instance()._attach(this);
+        }
+
+        ~ThreadStats()
+        {
+            instance()._detach(this);
+        }
+    };
+
+    std::mutex                   mutex   {};  //< Guards the registry and `retired`
+    std::vector<const LogSite *> sites   {};
+    std::vector<ThreadStats *>   threads {};
+    std::vector<ScopeSummary>    retired {};  //< Stats of exited threads, by site
+
+    inline static thread_local bool s_destroyed = false;
+
+    Profiler() = default;
+
+    void _attach(ThreadStats *local)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        threads.push_back(local);
+    }
+
+    void _detach(ThreadStats *local) noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        _mergeInto(retired, *local);
+
+        for (std::atomic<ScopeStats *> &chunk : local->chunks)
+            delete[] chunk.exchange(nullptr, std::memory_order_acq_rel);
+
+        std::erase(threads, local);
+        s_destroyed = true;
+    }
+
+    // Calling thread's stats, nullptr once destroyed at thread exit
+    [[nodiscard]]
+    static ThreadStats *_local() noexcept
+    {
+        if (s_destroyed) return nullptr;
+
+        thread_local ThreadStats s_stats {};
+        return &s_stats;
+    }
+
+    // Add a thread's stats to `out` (caller holds `mutex`)
+    void _mergeInto(std::vector<ScopeSummary> &out, const ThreadStats &local) const
+    {
+        out.resize(sites.size());
+
+        for (size_t c = 0; c < CHUNKS; ++c)
+        {
+            const ScopeStats *chunk = local.chunks[c].load(std::memory_order_acquire);
+            if (!chunk) continue;
+
+            for (size_t i = 0; i < CHUNK && c * CHUNK + i < out.size(); ++i)
+                out[c * CHUNK + i].merge(chunk[i]);
+        }
+    }
+
+    // Assign a profiler slot to `site`
+    uint32_t _register(LogSite &site) noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        if (const uint32_t id = site.profile_id.load(std::memory_order_relaxed)) return id;
+
+        sites.push_back(&site);
+        const auto id = static_cast<uint32_t>(sites.size());
+
+        site.profile_id.store(id, std::memory_order_release);
+        return id;
+    }
+
+public:
+    Profiler(const Profiler&) = delete;
+    Profiler &operator=(const Profiler&) = delete;
+
+    // Process-wide profiler, never destroyed so it outlives thread exit
+    [[nodiscard]]
+    static Profiler &instance() noexcept
+    {
+        static Profiler *s_profiler = [] {
+            Profiler *profiler = new Profiler{};
+
+            if constexpr (config::PROFILER_REPORT_AT_EXIT)
+                std::atexit([] { writeFd(FD_ERR, instance().report()); });
+
+            return profiler;
+        }();
+
+        return *s_profiler;
+    }
+
+    // Add one run of `site` lasting `ns`
+    void record(LogSite &site, uint64_t ns) noexcept
+    {
+        uint32_t id = site.profile_id.load(std::memory_order_acquire);
+        if (!id) id = _register(site);
+        if (id > config::PROFILER_MAX_SITES) return;
+
+        ThreadStats *local = _local();
+        if (!local) return;
+
+        const size_t index = id - 1;
+        std::atomic<ScopeStats *> &slot = local->chunks[index / CHUNK];
+
+        ScopeStats *chunk = slot.load(std::memory_order_relaxed);
+        if (!chunk)
+        {
+            chunk = new ScopeStats[CHUNK] {};
+            slot.store(chunk, std::memory_order_release);
+        }
+
+        chunk[index % CHUNK].add(ns);
+    }
+
+    // Stats of every site with at least one run, merged over all threads
+    [[nodiscard]]
+    std::vector<std::pair<const LogSite *, ScopeSummary>> snapshot()
+    {
+        std::vector<std::pair<const LogSite *, ScopeSummary>> out {};
+        std::scoped_lock<std::mutex> lock {mutex};
+
+        std::vector<ScopeSummary> merged = retired;
+        for (const ThreadStats *local : threads) _mergeInto(merged, *local);
+
+        for (size_t i = 0; i < merged.size() && i < config::PROFILER_MAX_SITES; ++i)
+            if (merged[i].count > 0) out.emplace_back(sites[i], merged[i]);
+
+        return out;
+    }
+
+    // Table of every profiled scope, by total time
+    [[nodiscard]]
+    std::string report()
+    {
+        auto rows = snapshot();
+        if (rows.empty()) return {};
+
+        std::ranges::sort(rows, std::greater{}, [](const auto &row) { return row.second.total; });
+
+        std::string out {"\n=== ZLOG PROFILE ===\n"};
+        auto it = std::back_inserter(out);
+
+        std::format_to(
+            it, "{:>10} {:>10} {:>9} {:>9} {:>9} {:>9} {:>9}  {}\n",
+            "calls", "total", "min", "p50", "p99", "p999", "max", "scope"
+        );
+
+        for (const auto &[site, stats] : rows)
+        {
+            std::format_to(
+                it, "{:>10} {:>10} {:>9} {:>9} {:>9} {:>9} {:>9}  {} [{}:{}]\n",
+                stats.count,
+                formatDuration(stats.total),
+                formatDuration(stats.min),
+                formatDuration(stats.percentile(0.50)),
+                formatDuration(stats.percentile(0.99)),
+                formatDuration(stats.percentile(0.999)),
+                formatDuration(stats.max),
+                site->FORMAT, site->LOC.FILE, site->LOC.LINE
+            );
+        }
+
+        return out;
+    }
+};
+
+} // namespace internal
+
+// Per-scope profile of every `ZTRC` site (with `config::ENABLE_PROFILER`)
+[[nodiscard]]
+inline std::string profileReport()
+{
+    return internal::Profiler::instance().report();
+}
+
+} // namespace zlog
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./stats.hpp"
+
+#include <memory>
+#include <format>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <utility>
+#include <algorithm>
+#include <string_view>
+
+namespace zlog {
+
+namespace internal {
+
+// String class which supports regular and format strings, stored inline
+// (heap only for text longer than `INLINE_CAPACITY`)
+class ProString final {
+public:
+    static constexpr size_t INLINE_CAPACITY = 256;
+
+private:
+    char                    buf[INLINE_CAPACITY];  //< Left uninitialized past `len`
+    size_t                  len  {0};
+    std::unique_ptr<char[]> heap {};               //< Oversized text
+
+    // Storage for `size` bytes
+    [[nodiscard]]
+    char *_reserve(size_t size)
+    {
+        if (size <= INLINE_CAPACITY) return buf;
+        heap = std::make_unique<char[]>(size);
+        return heap.get();
+    }
+
+    void _assign(std::string_view text)
+    {
+        len = text.size();
+        if (len > 0) std::memcpy(_reserve(len), text.data(), len);
+    }
+
+public:
+    ProString() noexcept {}
+
+    // Regular string constructor
+    ProString(std::string_view text) { _assign(text); }
+
+    // Format string constructor
+    template <typename... Args>
+    ProString(std::format_string<Args...> f_str, Args&&... args)
+    {
+        const StatsTimer<LogTiming::Format> timer {};
+        const auto result = std::format_to_n(buf, INLINE_CAPACITY, f_str, std::forward<Args>(args)...);
+        len = static_cast<size_t>(result.size);
+
+        // Too long for the inline buffer, format again into the heap
+        // (formatting only reads the arguments, forwarding twice is safe)
+        if (len > INLINE_CAPACITY) std::format_to(_reserve(len), f_str, std::forward<Args>(args)...);
+    }
+
+    ProString(const ProString &other) { _assign(other.view()); }
+
+    ProString(ProString &&other) noexcept
+        : len{other.len}
+        , heap{std::move(other.heap)}
+    {
+        if (!heap) std::memcpy(buf, other.buf, len);
+        other.len = 0;
+    }
+
+    ProString &operator=(const ProString &other)
+    {
+        if (this != &other)
+        {
+            heap.reset();
+            _assign(other.view());
+        }
+        return *this;
+    }
+
+    ProString &operator=(ProString &&other) noexcept
+    {
+        if (this != &other)
+        {
+            len  = other.len;
+            heap = std::move(other.heap);
+            if (!heap) std::memcpy(buf, other.buf, len);
+            other.len = 0;
+        }
+        return *this;
+    }
+
+    // Stored text
+    [[nodiscard]]
+    std::string_view view() const noexcept { return {heap ? heap.get() : buf, len}; }
+
+    // True is no text is provided
+    [[nodiscard]]
+    bool isEmpty() const noexcept { return len == 0; }
+
+    // Ostream support
+    friend std::ostream &operator<<(std::ostream &os, const ProString &ps)
+    {
+        return os << ps.view();
+    }
+};
+
+} // namespace internal
+
+} // namespace zlog
+
+// std::format support for ProString
+template <>
+struct std::formatter<zlog::internal::ProString> {
+    constexpr auto parse(std::format_parse_context &ctx) { return ctx.begin(); }
+
+    auto format(const zlog::internal::ProString &ps, std::format_context &ctx) const
+    {
+        const std::string_view text = ps.view();
+        return std::copy(text.begin(), text.end(), ctx.out());
+    }
+};
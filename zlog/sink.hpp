@@ -0,0 +1,876 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./buffer.hpp"
+#include "./lz.hpp"
+#include "./os.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
+#include <condition_variable>
+
+namespace zlog {
+
+// Rendered log line handed to sinks
+struct LogRecord {
+    LogLevel         level;  //< Severity of the record
+    std::string_view line;   //< Rendered line, including the trailing newline
+};
+
+// Destination for rendered log lines with its own level filter
+class Sink {
+    std::atomic<LogLevel> min_level;  //< Records below this level are skipped
+
+public:
+    explicit Sink(LogLevel min_level = LogLevel::Trace) noexcept : min_level{min_level} {}
+    virtual ~Sink() = default;
+
+    Sink(const Sink&) = delete;
+    Sink &operator=(const Sink&) = delete;
+
+    // True if records of `level` pass this sink's filter
+    [[nodiscard]]
+    bool accepts(LogLevel level) const noexcept
+    {
+        return level >= min_level.load(std::memory_order_relaxed);
+    }
+
+    void setLevel(LogLevel level) noexcept { min_level.store(level, std::memory_order_relaxed); }
+
+    // Write one accepted record (may be called from several threads at once)
+    virtual void write(const LogRecord &record) = 0;
+
+    // Write records in order, filtering by level (used by the asynchronous writer)
+    virtual void writeBatch(const LogRecord *records, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+            if (accepts(records[i].level)) write(records[i]);
+    }
+
+    // Push buffered data to the destination
+    virtual void flush() {}
+};
+
+namespace internal {
+
+// Appends `text` to `out` without ANSI escape sequences
+inline void stripAnsi(std::string_view text, std::string &out)
+{
+    size_t pos = 0;
+
+    while (pos < text.size())
+    {
+        const size_t esc = text.find('\033', pos);
+        out.append(text.substr(pos, esc - pos));
+
+        if (esc == std::string_view::npos) break;
+
+        const size_t end = text.find('m', esc);
+        pos = (end == std::string_view::npos) ? text.size() : end + 1;
+    }
+}
+
+} // namespace internal
+
+// stdout for Trace/Debug/Info, stderr for Warn/Error/Fatal (installed by default)
+class ConsoleSink final : public Sink {
+public:
+    using Sink::Sink;
+
+    void write(const LogRecord &record) override
+    {
+        const int fd = internal::fdFor(record.level);
+
+        if (internal::ThreadBuffer *buffer = internal::ThreadBuffer::local())
+        {
+            buffer->append(fd, record.line);
+            if (record.level == LogLevel::Fatal) buffer->flush();
+        }
+        else // Thread is exiting, write directly
+        {
+            const std::unique_lock<std::mutex> lock = internal::lockLog();
+            internal::writeFd(fd, record.line);
+        }
+    }
+
+    // One `writev` per run of same-descriptor records
+    void writeBatch(const LogRecord *records, size_t count) override
+    {
+        std::vector<std::string_view> parts {};
+        parts.reserve(count);
+
+        const std::unique_lock<std::mutex> lock = internal::lockLog();
+        int fd = -1;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!accepts(records[i].level)) continue;
+            const int next = internal::fdFor(records[i].level);
+
+            if (fd != next && !parts.empty())
+            {
+                internal::writeFdv(fd, parts.data(), parts.size());
+                parts.clear();
+            }
+
+            fd = next;
+            parts.push_back(records[i].line);
+        }
+
+        if (!parts.empty()) internal::writeFdv(fd, parts.data(), parts.size());
+    }
+
+    void flush() override { internal::ThreadBuffer::flushAll(); }
+};
+
+// Appends records to a file through a stdio buffer of `buffer_size` bytes
+class FileSink : public Sink {
+protected:
+    std::mutex        mutex   {};
+    std::FILE        *file    {nullptr};
+    const std::string PATH;
+    const size_t      BUFFER_SIZE;
+    const bool        STRIP_COLOR;  //< Remove ANSI escape sequences
+    std::string       plain   {};   //< Scratch for color stripped lines
+    size_t            written {0};  //< Bytes in the current file
+
+    // Open `PATH` for appending (caller holds `mutex`)
+    void _open() noexcept
+    {
+        file = std::fopen(PATH.c_str(), "ab");
+        if (!file) return;
+
+        if (BUFFER_SIZE > 0) std::setvbuf(file, nullptr, _IOFBF, BUFFER_SIZE);
+        else                 std::setvbuf(file, nullptr, _IONBF, 0);
+
+        std::error_code ec {};
+        const auto size = std::filesystem::file_size(PATH, ec);
+        written = ec ? 0 : static_cast<size_t>(size);
+    }
+
+    // Close the current file (caller holds `mutex`)
+    void _close() noexcept
+    {
+        if (file) std::fclose(file);
+        file = nullptr;
+    }
+
+    // `line` as it is written, color stripped into `plain` with `STRIP_COLOR` (caller holds `mutex`)
+    [[nodiscard]]
+    std::string_view _plain(std::string_view line)
+    {
+        if (!STRIP_COLOR) return line;
+
+        plain.clear();
+        internal::stripAnsi(line, plain);
+        return plain;
+    }
+
+    // Write one line returned by `_plain` (caller holds `mutex`)
+    void _append(std::string_view line)
+    {
+        if (!file) return;
+
+        written += std::fwrite(line.data(), 1, line.size(), file);
+        if (!BUFFER_SIZE) std::fflush(file);
+    }
+
+public:
+    explicit FileSink(
+        std::string path,
+        LogLevel min_level = LogLevel::Trace,
+        size_t buffer_size = 64 * 1024,
+        bool strip_color = true
+    )
+        : Sink{min_level}
+        , PATH{std::move(path)}
+        , BUFFER_SIZE{buffer_size}
+        , STRIP_COLOR{strip_color}
+    {
+        _open();
+    }
+
+    ~FileSink() override { _close(); }
+
+    // False if the file could not be opened
+    [[nodiscard]]
+    bool isOpen() const noexcept { return file != nullptr; }
+
+    void write(const LogRecord &record) override
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        _append(_plain(record.line));
+        if (record.level == LogLevel::Fatal && file) std::fflush(file);
+    }
+
+    void flush() override
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        if (file) std::fflush(file);
+    }
+};
+
+// File sink that rotates by size and/or age, keeping `max_files` old segments
+// as "PATH.1" (newest) ... "PATH.N" (oldest)
+class RotatingFileSink : public FileSink {
+protected:
+    using Clock = std::chrono::steady_clock;
+
+    const size_t               MAX_BYTES;  //< 0 disables size rotation
+    const std::chrono::seconds INTERVAL;   //< 0 disables time rotation
+    const size_t               MAX_FILES;  //< Rotated segments kept
+    Clock::time_point          opened_at {Clock::now()};
+
+    // Name of the `idx`-th rotated segment
+    [[nodiscard]]
+    std::string _segment(size_t idx) const { return PATH + "." + std::to_string(idx); }
+
+    // True if appending `bytes` should start a new file
+    [[nodiscard]]
+    bool _isDue(size_t bytes) const noexcept
+    {
+        if (MAX_BYTES > 0 && written > 0 && written + bytes > MAX_BYTES) return true;
+        return INTERVAL.count() > 0 && Clock::now() - opened_at >= INTERVAL;
+    }
+
+    // Shift segments up and start a new file (caller holds `mutex`)
+    virtual void _rotate()
+    {
+        _close();
+
+        std::error_code ec {};
+        std::filesystem::remove(_segment(MAX_FILES), ec);
+
+        for (size_t idx = MAX_FILES; idx > 1; --idx)
+            std::filesystem::rename(_segment(idx - 1), _segment(idx), ec);
+
+        if (MAX_FILES > 0) std::filesystem::rename(PATH, _segment(1), ec);
+        else               std::filesystem::remove(PATH, ec);
+
+        _open();
+        opened_at = Clock::now();
+    }
+
+public:
+    explicit RotatingFileSink(
+        std::string path,
+        size_t max_bytes,
+        size_t max_files = 5,
+        std::chrono::seconds interval = std::chrono::seconds{0},
+        LogLevel min_level = LogLevel::Trace,
+        size_t buffer_size = 64 * 1024,
+        bool strip_color = true
+    )
+        : FileSink{std::move(path), min_level, buffer_size, strip_color}
+        , MAX_BYTES{max_bytes}
+        , INTERVAL{interval}
+        , MAX_FILES{max_files}
+    {}
+
+    void write(const LogRecord &record) override
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        const std::string_view line = _plain(record.line);  // Sized as written, like `written`
+        if (_isDue(line.size())) _rotate();
+
+        _append(line);
+        if (record.level == LogLevel::Fatal && file) std::fflush(file);
+    }
+};
+
+// Appends records to `PATH` as a stream of compressed blocks (`zlog/lz.hpp`, read back with
+// `tools/lzcat`). Callers only copy their line into the pending block, full blocks are
+// compressed and written by a background thread. Blocks are self-delimiting and checksummed,
+// so a crash loses at most the lines not yet handed to the writer (see `max_delay`).
+// Rotates like `RotatingFileSink` once the compressed file passes `max_bytes`
+class CompressedFileSink final : public Sink {
+    using Clock = std::chrono::steady_clock;
+
+    const std::string               PATH;
+    const size_t                    BLOCK_BYTES;  //< Lines are compressed in blocks of about this size
+    const size_t                    MAX_BYTES;    //< 0 disables rotation
+    const size_t                    MAX_FILES;    //< Rotated segments kept
+    const std::chrono::milliseconds MAX_DELAY;    //< Partial blocks are written after this long
+    const bool                      STRIP_COLOR;  //< Remove ANSI escape sequences
+
+    std::mutex               mutex    {};
+    std::condition_variable  wake     {};         //< Signals the writer
+    std::condition_variable  done     {};         //< Signals `flush` callers
+    std::string              pending  {};         //< Block being filled
+    Clock::time_point        since    {};         //< First line of `pending`
+    std::vector<std::string> ready    {};         //< Blocks waiting for the writer
+    std::vector<std::string> spare    {};         //< Written blocks, reused for `pending`
+    uint64_t                 handed   {0};        //< Blocks given to the writer
+    uint64_t                 finished {0};        //< Blocks written
+    bool                     running  {true};
+    std::FILE               *file     {nullptr};  //< Only used by the writer after construction
+    size_t                   written  {0};        //< Compressed bytes in the current file
+    std::thread              writer   {};         //< Started last, after every other member
+
+    // Sinks alive, flushed at exit since the sink registry is never destroyed
+    struct LiveSinks {
+        std::mutex                        mutex {};
+        std::vector<CompressedFileSink *> sinks {};
+    };
+
+    [[nodiscard]]
+    static LiveSinks &_live()
+    {
+        static LiveSinks *s_live = [] {
+            std::atexit([] {
+                LiveSinks &live = _live();
+                std::scoped_lock<std::mutex> lock {live.mutex};
+                for (CompressedFileSink *sink : live.sinks) sink->flush();
+            });
+            return new LiveSinks{};
+        }();
+
+        return *s_live;
+    }
+
+    // Name of the `idx`-th rotated segment
+    [[nodiscard]]
+    std::string _segment(size_t idx) const { return PATH + "." + std::to_string(idx); }
+
+    // Length of the blocks of `PATH` (`size` bytes) without a last one cut short by a crash,
+    // walking block headers only
+    [[nodiscard]]
+    size_t _completeSize(size_t size) const noexcept
+    {
+        std::FILE *in = std::fopen(PATH.c_str(), "rb");
+        if (!in) return size;
+
+        size_t pos = 0;
+        uint32_t fields[4];  // MAGIC, raw_len, stored_len, checksum
+
+        while (pos < size)
+        {
+            if (size - pos < lz::HEADER_SIZE
+                || std::fseek(in, static_cast<long>(pos), SEEK_SET) != 0
+                || std::fread(fields, 1, lz::HEADER_SIZE, in) != lz::HEADER_SIZE) break;
+
+            // Damaged rather than cut short, kept as is (readers skip to the next valid block)
+            if (fields[0] != lz::MAGIC) { pos = size; break; }
+            if (size - pos - lz::HEADER_SIZE < fields[2]) break;
+
+            pos += lz::HEADER_SIZE + fields[2];
+        }
+
+        std::fclose(in);
+        return pos;
+    }
+
+    // Open `PATH` for appending, first dropping a block left incomplete by a crash so the
+    // blocks appended after it stay readable
+    void _open() noexcept
+    {
+        std::error_code ec {};
+        size_t size = static_cast<size_t>(std::filesystem::file_size(PATH, ec));
+        if (ec) size = 0;
+
+        if (const size_t complete = _completeSize(size); complete < size)
+        {
+            std::filesystem::resize_file(PATH, complete, ec);
+            if (!ec) size = complete;
+        }
+
+        file = std::fopen(PATH.c_str(), "ab");
+        written = size;
+    }
+
+    // Shift segments up and start a new file (writer thread)
+    void _rotate()
+    {
+        if (file) std::fclose(file);
+
+        std::error_code ec {};
+        std::filesystem::remove(_segment(MAX_FILES), ec);
+
+        for (size_t idx = MAX_FILES; idx > 1; --idx)
+            std::filesystem::rename(_segment(idx - 1), _segment(idx), ec);
+
+        if (MAX_FILES > 0) std::filesystem::rename(PATH, _segment(1), ec);
+        else               std::filesystem::remove(PATH, ec);
+
+        _open();
+    }
+
+    // Queue the pending block for the writer (caller holds `mutex`)
+    void _handOff()
+    {
+        if (pending.empty()) return;
+
+        ready.push_back(std::move(pending));
+        ++handed;
+
+        if (!spare.empty())
+        {
+            pending = std::move(spare.back());
+            spare.pop_back();
+        }
+        else pending = {};
+
+        pending.clear();
+        wake.notify_one();
+    }
+
+    // Compress and write the queued blocks until the sink is destroyed
+    void _run()
+    {
+        std::vector<std::string> blocks {};
+        std::string packed {};
+        std::unique_lock<std::mutex> lock {mutex};
+
+        while (true)
+        {
+            wake.wait_for(lock, MAX_DELAY, [this] { return !ready.empty() || !running; });
+
+            if (ready.empty() && !pending.empty() && Clock::now() - since >= MAX_DELAY) _handOff();
+            if (ready.empty())
+            {
+                if (!running) break;
+                continue;
+            }
+
+            blocks.swap(ready);
+            lock.unlock();
+
+            for (const std::string &block : blocks)
+            {
+                if (!file) break;
+                if (MAX_BYTES > 0 && written > 0 && written >= MAX_BYTES) _rotate();
+
+                packed.clear();
+                lz::putBlock(packed, block);
+                written += std::fwrite(packed.data(), 1, packed.size(), file);
+            }
+
+            if (file) std::fflush(file);
+
+            lock.lock();
+            finished += blocks.size();
+            for (std::string &block : blocks) spare.push_back(std::move(block));
+            blocks.clear();
+            done.notify_all();
+        }
+    }
+
+public:
+    explicit CompressedFileSink(
+        std::string path,
+        size_t max_bytes = 0,
+        size_t max_files = 5,
+        LogLevel min_level = LogLevel::Trace,
+        size_t block_bytes = 64 * 1024,
+        std::chrono::milliseconds max_delay = std::chrono::milliseconds{1000},
+        bool strip_color = true
+    )
+        : Sink{min_level}
+        , PATH{std::move(path)}
+        , BLOCK_BYTES{std::clamp<size_t>(block_bytes, 1024, UINT32_MAX / 2)}
+        , MAX_BYTES{max_bytes}
+        , MAX_FILES{max_files}
+        , MAX_DELAY{std::max(max_delay, std::chrono::milliseconds{1})}
+        , STRIP_COLOR{strip_color}
+    {
+        _open();
+        pending.reserve(BLOCK_BYTES);
+        writer = std::thread{[this] { _run(); }};
+
+        LiveSinks &live = _live();
+        std::scoped_lock<std::mutex> lock {live.mutex};
+        live.sinks.push_back(this);
+    }
+
+    ~CompressedFileSink() override
+    {
+        {
+            LiveSinks &live = _live();
+            std::scoped_lock<std::mutex> lock {live.mutex};
+            std::erase(live.sinks, this);
+        }
+
+        {
+            std::scoped_lock<std::mutex> lock {mutex};
+            _handOff();
+            running = false;
+            wake.notify_one();
+        }
+
+        writer.join();
+        if (file) std::fclose(file);
+    }
+
+    // False if the file could not be opened
+    [[nodiscard]]
+    bool isOpen() const noexcept { return file != nullptr; }
+
+    void write(const LogRecord &record) override
+    {
+        {
+            std::scoped_lock<std::mutex> lock {mutex};
+
+            if (pending.empty()) since = Clock::now();
+
+            if (STRIP_COLOR) internal::stripAnsi(record.line, pending);
+            else             pending += record.line;
+
+            if (pending.size() >= BLOCK_BYTES) _handOff();
+        }
+
+        if (record.level == LogLevel::Fatal) flush();
+    }
+
+    // Wait until every line written so far is compressed and in the file
+    void flush() override
+    {
+        std::unique_lock<std::mutex> lock {mutex};
+        _handOff();
+
+        const uint64_t target = handed;
+        done.wait(lock, [&] { return finished >= target; });
+    }
+};
+
+#ifndef _WIN32
+
+// Writes into pre-sized memory mapped segments "PATH.0", "PATH.1", ... without locks or a
+// syscall per line: each line reserves its bytes with one fetch-add and is copied in place.
+// Lines are in the page cache as soon as they are copied, so they survive a crash of the
+// process; the unused end of a segment reads as NUL bytes until the segment is closed
+class MmapFileSink final : public Sink {
+    // One mapped segment, the two control blocks are recycled and never freed
+    struct Segment {
+        std::atomic<size_t>   used    {0};        //< Bytes reserved, may pass `size`
+        std::atomic<uint32_t> writers {0};        //< Threads using `base`
+        std::atomic<size_t>   index   {0};        //< Segment file number
+        char                 *base    {nullptr};
+        size_t                size    {0};
+        size_t                end     {0};        //< Length to keep once retired
+        int                   fd      {-1};
+    };
+
+    const std::string      PATH;
+    const size_t           SEGMENT_BYTES;
+    const bool             STRIP_COLOR;   //< Remove ANSI escape sequences
+    Segment                segments[2] {};
+    std::atomic<Segment *> current     {nullptr};  //< nullptr if a segment could not be created
+    size_t                 next_index  {0};        //< Number of the next segment file
+
+    // Map a new segment file into `seg` (only called by the thread that fills the current one)
+    bool _open(Segment &seg) noexcept
+    {
+        const std::string name = PATH + "." + std::to_string(next_index++);
+
+        const int fd = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+
+        void *base = (::ftruncate(fd, static_cast<off_t>(SEGMENT_BYTES)) == 0)
+            ? ::mmap(nullptr, SEGMENT_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+            : MAP_FAILED;
+
+        if (base == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        seg.index.store(next_index - 1, std::memory_order_relaxed);
+        seg.fd   = fd;
+        seg.base = static_cast<char *>(base);
+        seg.size = SEGMENT_BYTES;
+        seg.end  = 0;
+        seg.used.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Unmap `seg` once no thread uses it, cutting its file to the bytes written
+    static void _close(Segment &seg) noexcept
+    {
+        while (seg.writers.load() != 0) std::this_thread::yield();
+        if (!seg.base) return;
+
+        ::munmap(seg.base, seg.size);
+
+        // On failure the file only keeps its NUL padding
+        [[maybe_unused]] const int cut = ::ftruncate(seg.fd, static_cast<off_t>(seg.end));
+        ::close(seg.fd);
+
+        seg.base = nullptr;
+        seg.fd   = -1;
+    }
+
+    // Current segment with its writer count taken, nullptr if there is none
+    [[nodiscard]]
+    Segment *_acquire() noexcept
+    {
+        while (true)
+        {
+            Segment *seg = current.load(std::memory_order_acquire);
+            if (!seg) return nullptr;
+
+            // Retired segments are only unmapped after their writers leave, so check again
+            seg->writers.fetch_add(1);
+            if (current.load() == seg) return seg;
+            seg->writers.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    // Switch from `full` (whose data ends at `end`) to a new segment
+    void _roll(Segment *full, size_t end) noexcept
+    {
+        Segment *next = (full == &segments[0]) ? &segments[1] : &segments[0];
+        full->end = end;
+
+        _close(*next);
+        current.store(_open(*next) ? next : nullptr);
+    }
+
+public:
+    explicit MmapFileSink(
+        std::string path,
+        size_t segment_bytes = 64 * 1024 * 1024,
+        LogLevel min_level = LogLevel::Trace,
+        bool strip_color = true
+    )
+        : Sink{min_level}
+        , PATH{std::move(path)}
+        , SEGMENT_BYTES{std::max<size_t>(segment_bytes, 4096)}
+        , STRIP_COLOR{strip_color}
+    {
+        // Continue after the segments of earlier runs
+        std::error_code ec {};
+        while (std::filesystem::exists(PATH + "." + std::to_string(next_index), ec)) ++next_index;
+
+        if (_open(segments[0])) current.store(&segments[0]);
+    }
+
+    ~MmapFileSink() override
+    {
+        if (Segment *seg = current.exchange(nullptr))
+            seg->end = std::min(seg->used.load(), seg->size);
+
+        _close(segments[0]);
+        _close(segments[1]);
+    }
+
+    // False if no segment could be created
+    [[nodiscard]]
+    bool isOpen() const noexcept { return current.load(std::memory_order_relaxed) != nullptr; }
+
+    void write(const LogRecord &record) override
+    {
+        std::string_view line = record.line;
+
+        if (STRIP_COLOR)
+        {
+            thread_local std::string s_plain {};
+            s_plain.clear();
+            internal::stripAnsi(line, s_plain);
+            line = s_plain;
+        }
+
+        line = line.substr(0, SEGMENT_BYTES);
+        if (line.empty()) return;
+
+        while (Segment *seg = _acquire())
+        {
+            const size_t index = seg->index.load(std::memory_order_relaxed);
+            const size_t size  = seg->size;
+            const size_t pos   = seg->used.fetch_add(line.size(), std::memory_order_relaxed);
+
+            if (pos + line.size() <= size)
+            {
+                std::memcpy(seg->base + pos, line.data(), line.size());
+                seg->writers.fetch_sub(1, std::memory_order_release);
+                return;
+            }
+
+            seg->writers.fetch_sub(1, std::memory_order_release);
+
+            // The reservation crossing the end rolls over, later ones wait for it (the
+            // control block may already hold a newer segment)
+            if (pos <= size) _roll(seg, pos);
+            else while (current.load(std::memory_order_acquire) == seg && seg->index.load() == index)
+                std::this_thread::yield();
+        }
+    }
+
+    // Start writing the current segment back to disk (not needed to survive a process crash)
+    void flush() override
+    {
+        if (Segment *seg = _acquire())
+        {
+            ::msync(seg->base, seg->size, MS_ASYNC);
+            seg->writers.fetch_sub(1, std::memory_order_release);
+        }
+    }
+};
+
+#endif
+
+// Keeps the last `capacity` lines in memory
+class MemorySink final : public Sink {
+    mutable std::mutex       mutex {};
+    std::vector<std::string> ring  {};  //< Slots reuse their capacity
+    size_t                   next  {0};
+    size_t                   count {0};
+
+public:
+    explicit MemorySink(size_t capacity, LogLevel min_level = LogLevel::Trace)
+        : Sink{min_level}
+        , ring(capacity > 0 ? capacity : 1)
+    {}
+
+    void write(const LogRecord &record) override
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        ring[next].assign(record.line);
+
+        next = (next + 1) % ring.size();
+        count = std::min(count + 1, ring.size());
+    }
+
+    // Stored lines, oldest first
+    [[nodiscard]]
+    std::vector<std::string> lines() const
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        std::vector<std::string> out {};
+        out.reserve(count);
+
+        for (size_t i = 0; i < count; ++i)
+            out.push_back(ring[(next + ring.size() - count + i) % ring.size()]);
+
+        return out;
+    }
+
+    void clear() noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        next = count = 0;
+    }
+};
+
+namespace internal {
+
+using SinkList = std::vector<std::shared_ptr<Sink>>;
+
+// Copy-on-write list of active sinks, read without locking on the log path
+class SinkRegistry final {
+    std::mutex                                   mutex {};  //< Serializes modifications
+    std::atomic<std::shared_ptr<const SinkList>> list  {};
+
+    SinkRegistry(std::shared_ptr<Sink> console)
+        : list{std::make_shared<const SinkList>(SinkList{std::move(console)})}
+    {}
+
+    // Replace the list with `edit(copy)`
+    template <typename Fn>
+    void _modify(Fn &&edit)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        SinkList copy = *list.load(std::memory_order_acquire);
+        edit(copy);
+        list.store(std::make_shared<const SinkList>(std::move(copy)), std::memory_order_release);
+    }
+
+public:
+    // Default console sink
+    [[nodiscard]]
+    static const std::shared_ptr<ConsoleSink> &console() noexcept
+    {
+        static const std::shared_ptr<ConsoleSink> s_console = std::make_shared<ConsoleSink>();
+        return s_console;
+    }
+
+    // Process-wide registry, never destroyed so it outlives static destruction
+    [[nodiscard]]
+    static SinkRegistry &instance() noexcept
+    {
+        static SinkRegistry *s_registry = new SinkRegistry{console()};
+        return *s_registry;
+    }
+
+    [[nodiscard]]
+    std::shared_ptr<const SinkList> snapshot() const noexcept
+    {
+        return list.load(std::memory_order_acquire);
+    }
+
+    void add(std::shared_ptr<Sink> sink)
+    {
+        _modify([&](SinkList &sinks) { sinks.push_back(std::move(sink)); });
+    }
+
+    void remove(const std::shared_ptr<Sink> &sink)
+    {
+        _modify([&](SinkList &sinks) { std::erase(sinks, sink); });
+    }
+
+    void clear()
+    {
+        _modify([](SinkList &sinks) { sinks.clear(); });
+    }
+
+    // Fan a record out to every accepting sink
+    void dispatch(const LogRecord &record) const
+    {
+        for (const std::shared_ptr<Sink> &sink : *snapshot())
+            if (sink->accepts(record.level)) sink->write(record);
+    }
+
+    // Fan a batch out to every sink
+    void dispatchBatch(const LogRecord *records, size_t count) const
+    {
+        for (const std::shared_ptr<Sink> &sink : *snapshot())
+            sink->writeBatch(records, count);
+    }
+
+    void flush() const
+    {
+        for (const std::shared_ptr<Sink> &sink : *snapshot()) sink->flush();
+    }
+};
+
+} // namespace internal
+
+// Add a sink receiving every record it accepts
+inline void addSink(std::shared_ptr<Sink> sink)
+{
+    internal::SinkRegistry::instance().add(std::move(sink));
+}
+
+// Remove a previously added sink
+inline void removeSink(const std::shared_ptr<Sink> &sink)
+{
+    internal::SinkRegistry::instance().remove(sink);
+}
+
+// Remove every sink, including the default console sink
+inline void clearSinks()
+{
+    internal::SinkRegistry::instance().clear();
+}
+
+// Default console sink (e.g. to change its level or remove it)
+[[nodiscard]]
+inline std::shared_ptr<Sink> consoleSink() noexcept
+{
+    return internal::SinkRegistry::console();
+}
+
+} // namespace zlog
@@ -0,0 +1,333 @@
+#pragma once
+
+#include "./config.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <string_view>
+
+namespace zlog {
+
+// Emission limits of one call site (0 disables each part)
+struct RateLimit {
+    uint32_t per_sec {config::RATE_LIMIT_PER_SEC};  //< Token bucket refill rate
+    uint32_t burst   {config::RATE_LIMIT_BURST};    //< Token bucket size
+    uint32_t first_n {0};                           //< Log the first N hits...
+    uint32_t every_m {0};                           //< ...then every Mth (none if 0)
+};
+
+// Limit of sites that are never limited (scope tracing)
+static constexpr RateLimit NO_LIMIT {0, 0, 0, 0};
+
+// Static metadata of one logging macro expansion, constant-initialized and
+// registered on its first hit (see `zlog::forEachSite`)
+//
+// `FORMAT` is the spelling of the call site's first argument (escapes are not decoded), so
+// text lines are still formatted from the literal passed with the arguments, checked at compile
+// time; binary logging and the tools use `FORMAT`
+struct LogSite {
+    const LogLevel         LEVEL;
+    const SourceLoc        LOC;
+    const std::string_view FORMAT;      //< Format string (or message) as written at the call site
+    const std::string_view TAG;         //< Macro family, e.g. "ZINFO", "ZTRC", "ZCAUTION"
+    const RateLimit        LIMIT {};
+
+    std::atomic<bool>      enabled    {true};
+    std::atomic<uint64_t>  hits       {0};        //< Hits not counted per thread (see `zlog::siteHits`)
+    std::atomic<uint64_t>  suppressed {0};        //< Hits dropped by `LIMIT` since the last emitted line
+    std::atomic<uint64_t>  limit_tat  {0};        //< Rate limiter theoretical arrival time (steady ns)
+    std::atomic<uint64_t>  last_hash  {0};        //< Hash of the last emitted message (`COLLAPSE_REPEATS`)
+    std::atomic<uint64_t>  last_ms    {0};        //< Time of the last emitted message (steady ms)
+    std::atomic<uint64_t>  repeats    {0};        //< Collapsed repeats of the last message
+    std::atomic<uint32_t>  binary_id  {0};        //< Binary log id, 0 until its site record is written
+    std::atomic<uint32_t>  profile_id {0};        //< Profiler slot, 0 until first profiled run
+    std::atomic<uint32_t>  hit_id     {0};        //< Per-thread hit counter slot, 0 until registered
+    LogSite               *next       {nullptr};  //< Registry link
+};
+
+namespace internal {
+
+// Head of the registered sites (intrusive list, sites are never removed)
+inline constinit std::atomic<LogSite *> s_site_head {nullptr};
+
+// Next `LogSite::hit_id` (ids lost to racing first hits are skipped)
+inline constinit std::atomic<uint32_t> s_next_hit_id {1};
+
+// Per-thread hit counters of the registered sites, so counting a hit is a relaxed load and
+// store on a cache line no other thread writes; exiting threads add theirs to `LogSite::hits`
+class SiteHits final {
+    static constexpr size_t CHUNK  = 64;  //< Sites per lazily allocated block
+    static constexpr size_t CHUNKS = 64;
+
+public:
+    static constexpr size_t MAX_SITES = CHUNK * CHUNKS;  //< Further sites share `LogSite::hits`
+
+private:
+    struct alignas(64) Chunk {
+        std::atomic<uint64_t> counts[CHUNK] {};
+    };
+
+    // Per-thread counters, indexed by hit id - 1
+    struct ThreadHits {
+        std::atomic<Chunk *> chunks[CHUNKS] {};
+
+        ThreadHits()
+        {
+            instance()._attach(this);
+        }
+
+        ~ThreadHits()
+        {
+            instance()._detach(this);
+        }
+    };
+
+    std::mutex                mutex   {};  //< Guards `threads` and merges into `LogSite::hits`
+    std::vector<ThreadHits *> threads {};
+
+    inline static thread_local bool s_destroyed = false;
+
+    SiteHits() = default;
+
+    void _attach(ThreadHits *local)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        threads.push_back(local);
+    }
+
+    void _detach(ThreadHits *local) noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+
+        for (LogSite *site = s_site_head.load(std::memory_order_acquire); site; site = site->next)
+            if (const uint64_t count = _count(*local, site->hit_id.load(std::memory_order_relaxed)))
+                site->hits.fetch_add(count, std::memory_order_relaxed);
+
+        for (std::atomic<Chunk *> &chunk : local->chunks)
+            delete chunk.exchange(nullptr, std::memory_order_acq_rel);
+
+        std::erase(threads, local);
+        s_destroyed = true;
+    }
+
+    // Calling thread's counters, nullptr once destroyed at thread exit
+    [[nodiscard]]
+    static ThreadHits *_local() noexcept
+    {
+        if (s_destroyed) return nullptr;
+
+        thread_local ThreadHits s_hits {};
+        return &s_hits;
+    }
+
+    // Hits of site `id` on one thread
+    [[nodiscard]]
+    static uint64_t _count(const ThreadHits &local, uint32_t id) noexcept
+    {
+        if (id == 0 || id > MAX_SITES) return 0;
+
+        const Chunk *chunk = local.chunks[(id - 1) / CHUNK].load(std::memory_order_acquire);
+        return chunk ? chunk->counts[(id - 1) % CHUNK].load(std::memory_order_relaxed) : 0;
+    }
+
+public:
+    SiteHits(const SiteHits&) = delete;
+    SiteHits &operator=(const SiteHits&) = delete;
+
+    // Process-wide counters, never destroyed so they outlive thread exit
+    [[nodiscard]]
+    static SiteHits &instance() noexcept
+    {
+        static SiteHits *s_hits = new SiteHits{};
+        return *s_hits;
+    }
+
+    // Count a hit of site `id` on the calling thread, false if it has to be counted in
+    // `LogSite::hits` instead (id out of range, thread exiting)
+    [[nodiscard]]
+    static bool count(uint32_t id) noexcept
+    {
+        if (id > MAX_SITES) return false;
+
+        ThreadHits *local = _local();
+        if (!local) return false;
+
+        std::atomic<Chunk *> &slot = local->chunks[(id - 1) / CHUNK];
+
+        Chunk *chunk = slot.load(std::memory_order_relaxed);
+        if (!chunk)
+        {
+            chunk = new Chunk{};
+            slot.store(chunk, std::memory_order_release);
+        }
+
+        std::atomic<uint64_t> &value = chunk->counts[(id - 1) % CHUNK];
+        value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Hits of `site` over every thread
+    [[nodiscard]]
+    uint64_t total(const LogSite &site) noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+
+        const uint32_t id = site.hit_id.load(std::memory_order_relaxed);
+        uint64_t hits = site.hits.load(std::memory_order_relaxed);
+
+        for (const ThreadHits *local : threads) hits += _count(*local, id);
+        return hits;
+    }
+};
+
+// Give `site` its hit id and add it to the registry, once (returns the id)
+[[gnu::cold]]
+inline uint32_t _registerSite(LogSite &site) noexcept
+{
+    const uint32_t id = s_next_hit_id.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t current = 0;
+    if (!site.hit_id.compare_exchange_strong(current, id, std::memory_order_acq_rel)) return current;
+
+    LogSite *head = s_site_head.load(std::memory_order_relaxed);
+    do site.next = head;
+    while (!s_site_head.compare_exchange_weak(head, &site, std::memory_order_release, std::memory_order_relaxed));
+
+    return id;
+}
+
+// Format text from the stringified macro arguments: the first string literal
+// without its quotes, or the whole text if it does not start with one
+[[nodiscard]]
+consteval std::string_view siteFormat(std::string_view args) noexcept
+{
+    if (!args.starts_with('"')) return args;
+
+    for (size_t i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == '\\') ++i;
+        else if (args[i] == '"') return args.substr(1, i - 1);
+    }
+
+    return args;
+}
+
+// True if hit number `n` (from 0) of `site` passes `LogSite::LIMIT`, lock-free:
+// "first N then every Mth" reuses the hit counter, the token bucket is a GCRA
+// on one atomic that is not written while the site is being limited
+[[nodiscard]]
+inline bool passesLimit(LogSite &site, uint64_t n) noexcept
+{
+    const RateLimit &limit = site.LIMIT;
+
+    if (limit.first_n != 0 || limit.every_m != 0)
+    {
+        if (n >= limit.first_n && (limit.every_m == 0 || (n - limit.first_n) % limit.every_m != 0))
+            return false;
+    }
+
+    if (limit.per_sec == 0) return true;
+
+    const uint64_t interval  = 1'000'000'000 / limit.per_sec;
+    const uint64_t tolerance = interval * (limit.burst > 0 ? limit.burst - 1 : 0);
+    const auto     now       = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()
+    );
+
+    uint64_t tat = site.limit_tat.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        if (tat > now + tolerance) return false;
+
+        if (site.limit_tat.compare_exchange_weak(tat, std::max(tat, now) + interval, std::memory_order_relaxed))
+            return true;
+    }
+}
+
+// True with probability `rate` (0..1), from a per-thread xorshift generator
+[[nodiscard]]
+inline bool sampled(double rate) noexcept
+{
+    if (rate >= 1.0) return true;
+    if (!(rate > 0.0)) return false;
+
+    thread_local constinit uint64_t s_state = 0;
+
+    if (s_state == 0) [[unlikely]]
+    {
+        // splitmix64 of the thread's state address and the time, never 0
+        uint64_t seed = reinterpret_cast<uintptr_t>(&s_state)
+                      ^ static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+        seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+        s_state = (seed ^ (seed >> 31)) | 1;
+    }
+
+    s_state ^= s_state >> 12;
+    s_state ^= s_state << 25;
+    s_state ^= s_state >> 27;
+
+    // xorshift64* output against `rate` scaled to 2^64 (folded for constant rates)
+    return s_state * 0x2545F4914F6CDD1Dull < static_cast<uint64_t>(rate * 0x1.0p64);
+}
+
+// Count a hit of `site` (registering it on the first), true if the site is
+// enabled and within its limit; no locked instruction unless the limit needs the hit number
+inline bool hitSite(LogSite &site) noexcept
+{
+    uint32_t id = site.hit_id.load(std::memory_order_relaxed);
+    if (id == 0) [[unlikely]] id = _registerSite(site);
+
+    // "First N then every Mth" needs the exact hit number, other sites count per thread
+    uint64_t n = 0;
+    if (site.LIMIT.first_n != 0 || site.LIMIT.every_m != 0 || !SiteHits::count(id))
+        n = site.hits.fetch_add(1, std::memory_order_relaxed);
+
+    if (!site.enabled.load(std::memory_order_relaxed)) return false;
+    if (passesLimit(site, n)) return true;
+
+    site.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+} // namespace internal
+
+// Call `fn(LogSite&)` for every site hit so far, most recent first
+template <typename Fn>
+inline void forEachSite(Fn &&fn)
+{
+    for (LogSite *site = internal::s_site_head.load(std::memory_order_acquire); site; site = site->next)
+        fn(*site);
+}
+
+// Hits of `site` so far, over all threads
+[[nodiscard]]
+inline uint64_t siteHits(const LogSite &site) noexcept
+{
+    return internal::SiteHits::instance().total(site);
+}
+
+// Enable or disable the sites hit so far in files ending with `file` (at `line`, or any
+// line if 0), returns the number of sites changed
+inline size_t setSiteEnabled(std::string_view file, uint32_t line, bool enabled) noexcept
+{
+    size_t changed = 0;
+
+    forEachSite([&](LogSite &site) {
+        if (site.LOC.isEmpty() || !std::string_view{site.LOC.FILE}.ends_with(file)) return;
+        if (line != 0 && site.LOC.LINE != line) return;
+
+        site.enabled.store(enabled, std::memory_order_relaxed);
+        ++changed;
+    });
+
+    return changed;
+}
+
+} // namespace zlog
@@ -0,0 +1,298 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./os.hpp"
+#include "./profiler.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <string_view>
+
+namespace zlog {
+
+// Logger activity since start, merged over threads (with `config::ENABLE_LOG_STATS`)
+struct LogStats {
+    static constexpr size_t LEVELS = 6;
+
+    uint64_t               lines[LEVELS] {};   //< Lines handed to the sinks or the queue, by `LogLevel`
+    uint64_t               bytes         {0};  //< Rendered bytes handed to the sinks or the queue
+    internal::ScopeSummary format        {};   //< Formatting a message (ns)
+    internal::ScopeSummary render        {};   //< Rendering the line around a message (ns)
+    internal::ScopeSummary dispatch      {};   //< Handing a line to the sinks or the queue (ns)
+    internal::ScopeSummary lock_wait     {};   //< Waiting for the output mutex, per write (ns)
+    uint64_t               queue_depth   {0};  //< Records waiting for the writer (`ENABLE_ASYNC`)
+    uint64_t               queue_peak    {0};  //< Largest queue depth seen by a push
+    uint64_t               dropped       {0};  //< Records lost to `config::ASYNC_OVERFLOW`
+};
+
+namespace internal {
+
+// Timed steps of a log line
+enum class LogTiming : uint8_t { Format, Render, Dispatch, LockWait };
+
+// Steady clock in nanoseconds
+[[nodiscard]]
+inline uint64_t _statsNow() noexcept
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+}
+
+// Aggregates the logger's own activity in per-thread tables, merged on demand
+class LogStatsRegistry final {
+    static constexpr size_t TIMINGS = 4;
+
+    // Per-thread counters, only written by the owning thread
+    struct ThreadStats {
+        std::atomic<uint64_t> lines[LogStats::LEVELS] {};
+        std::atomic<uint64_t> bytes                   {0};
+        ScopeStats            timings[TIMINGS]        {};  //< By `LogTiming`
+
+        ThreadStats()
+        {
+            instance()._attach(this);
+        }
+
+        ~ThreadStats()
+        {
+            instance()._detach(this);
+        }
+    };
+
+    std::mutex                 mutex   {};  //< Guards `threads` and `retired`
+    std::vector<ThreadStats *> threads {};
+    LogStats                   retired {};  //< Stats of exited threads
+
+    std::atomic<uint64_t> queue_depth {0};  //< Only written by the asynchronous writer
+    std::atomic<uint64_t> queue_peak  {0};  //< Raised by every pushing thread
+    std::atomic<uint64_t> dropped     {0};  //< Only written by the asynchronous writer
+
+    inline static thread_local bool s_destroyed = false;
+
+    LogStatsRegistry()
+    {
+        if constexpr (config::LOG_STATS_DUMP_MS > 0)
+            std::thread{[this] { _run(); }}.detach();
+    }
+
+    [[noreturn]]
+    void _run()
+    {
+        while (true)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{config::LOG_STATS_DUMP_MS});
+            writeFd(FD_ERR, report());
+        }
+    }
+
+    void _attach(ThreadStats *local)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        threads.push_back(local);
+    }
+
+    void _detach(ThreadStats *local) noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        _mergeInto(retired, *local);
+        std::erase(threads, local);
+        s_destroyed = true;
+    }
+
+    // Calling thread's stats, nullptr once destroyed at thread exit
+    [[nodiscard]]
+    static ThreadStats *_local() noexcept
+    {
+        if (s_destroyed) return nullptr;
+
+        thread_local ThreadStats s_stats {};
+        return &s_stats;
+    }
+
+    // Add a thread's stats to `out` (caller holds `mutex`)
+    static void _mergeInto(LogStats &out, const ThreadStats &local) noexcept
+    {
+        for (size_t i = 0; i < LogStats::LEVELS; ++i)
+            out.lines[i] += local.lines[i].load(std::memory_order_relaxed);
+
+        out.bytes += local.bytes.load(std::memory_order_relaxed);
+
+        out.format   .merge(local.timings[static_cast<size_t>(LogTiming::Format)]);
+        out.render   .merge(local.timings[static_cast<size_t>(LogTiming::Render)]);
+        out.dispatch .merge(local.timings[static_cast<size_t>(LogTiming::Dispatch)]);
+        out.lock_wait.merge(local.timings[static_cast<size_t>(LogTiming::LockWait)]);
+    }
+
+    static void _bump(std::atomic<uint64_t> &value, uint64_t by) noexcept
+    {
+        value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+public:
+    LogStatsRegistry(const LogStatsRegistry&) = delete;
+    LogStatsRegistry &operator=(const LogStatsRegistry&) = delete;
+
+    // Process-wide stats, never destroyed so they outlive thread exit
+    [[nodiscard]]
+    static LogStatsRegistry &instance() noexcept
+    {
+        static LogStatsRegistry *s_registry = [] {
+            LogStatsRegistry *registry = new LogStatsRegistry{};
+
+            if constexpr (config::LOG_STATS_AT_EXIT)
+                std::atexit([] { writeFd(FD_ERR, instance().report()); });
+
+            return registry;
+        }();
+
+        return *s_registry;
+    }
+
+    // Count one line of `bytes` handed to the sinks or the queue
+    void line(LogLevel lvl, size_t bytes) noexcept
+    {
+        ThreadStats *local = _local();
+        if (!local) return;
+
+        _bump(local->lines[static_cast<size_t>(lvl)], 1);
+        _bump(local->bytes, bytes);
+    }
+
+    void time(LogTiming step, uint64_t ns) noexcept
+    {
+        if (ThreadStats *local = _local()) local->timings[static_cast<size_t>(step)].add(ns);
+    }
+
+    // Queue state seen by the asynchronous writer
+    void queue(uint64_t depth, uint64_t dropped_records) noexcept
+    {
+        queue_depth.store(depth, std::memory_order_relaxed);
+        dropped.store(dropped_records, std::memory_order_relaxed);
+    }
+
+    // Queue depth right after a push, kept if it is the largest so far (only written while it rises)
+    void queuePeak(uint64_t depth) noexcept
+    {
+        uint64_t peak = queue_peak.load(std::memory_order_relaxed);
+        while (depth > peak && !queue_peak.compare_exchange_weak(peak, depth, std::memory_order_relaxed)) {}
+    }
+
+    [[nodiscard]]
+    LogStats snapshot()
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+
+        LogStats out = retired;
+        for (const ThreadStats *local : threads) _mergeInto(out, *local);
+
+        out.queue_depth = queue_depth.load(std::memory_order_relaxed);
+        out.queue_peak  = queue_peak.load(std::memory_order_relaxed);
+        out.dropped     = dropped.load(std::memory_order_relaxed);
+        return out;
+    }
+
+    // Lines per level, bytes, a timing table and the queue state
+    [[nodiscard]]
+    std::string report()
+    {
+        const LogStats stats = snapshot();
+
+        uint64_t lines = 0;
+        for (const uint64_t count : stats.lines) lines += count;
+
+        std::string out {"\n=== ZLOG STATS ===\n"};
+        auto it = std::back_inserter(out);
+
+        std::format_to(
+            it, "lines: {} ({} bytes), trace {}, debug {}, info {}, warn {}, error {}, fatal {}\n",
+            lines, stats.bytes, stats.lines[0], stats.lines[1], stats.lines[2],
+            stats.lines[3], stats.lines[4], stats.lines[5]
+        );
+
+        std::format_to(
+            it, "{:>10} {:>10} {:>9} {:>9} {:>9} {:>9} {:>9}  {}\n",
+            "count", "total", "min", "p50", "p99", "p999", "max", "step"
+        );
+
+        const auto row = [&](const ScopeSummary &timing, std::string_view step) {
+            if (timing.count == 0) return;
+
+            std::format_to(
+                it, "{:>10} {:>10} {:>9} {:>9} {:>9} {:>9} {:>9}  {}\n",
+                timing.count,
+                formatDuration(timing.total),
+                formatDuration(timing.min),
+                formatDuration(timing.percentile(0.50)),
+                formatDuration(timing.percentile(0.99)),
+                formatDuration(timing.percentile(0.999)),
+                formatDuration(timing.max),
+                step
+            );
+        };
+
+        row(stats.format   , "format");
+        row(stats.render   , "render");
+        row(stats.dispatch , "dispatch");
+        row(stats.lock_wait, "output lock wait");
+
+        if constexpr (config::ENABLE_ASYNC)
+            std::format_to(
+                it, "queue: depth {}, peak {}, dropped {}\n",
+                stats.queue_depth, stats.queue_peak, stats.dropped
+            );
+
+        return out;
+    }
+};
+
+// Records its lifetime as `STEP` (nothing without `config::ENABLE_LOG_STATS`)
+template <LogTiming STEP>
+class StatsTimer final {
+    uint64_t start {0};
+
+public:
+    StatsTimer() noexcept
+    {
+        if constexpr (config::ENABLE_LOG_STATS) start = _statsNow();
+    }
+
+    ~StatsTimer()
+    {
+        if constexpr (config::ENABLE_LOG_STATS)
+            LogStatsRegistry::instance().time(STEP, _statsNow() - start);
+    }
+
+    StatsTimer(const StatsTimer&) = delete;
+    StatsTimer &operator=(const StatsTimer&) = delete;
+};
+
+} // namespace internal
+
+// Logger activity since start (empty without `config::ENABLE_LOG_STATS`)
+[[nodiscard]]
+inline LogStats logStats()
+{
+    if constexpr (!config::ENABLE_LOG_STATS) return {};
+    else return internal::LogStatsRegistry::instance().snapshot();
+}
+
+// Printable `logStats()`, also written to stderr at exit and every `config::LOG_STATS_DUMP_MS`
+[[nodiscard]]
+inline std::string logStatsReport()
+{
+    if constexpr (!config::ENABLE_LOG_STATS) return {};
+    else return internal::LogStatsRegistry::instance().report();
+}
+
+} // namespace zlog
@@ -3,6 +3,23 @@
 #include "./config.hpp"
 #include "./log.hpp"
 
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include <exception>
+#include <type_traits>
 #include <string_view>
 
 namespace zlog {
@@ -23,9 +40,9 @@ namespace internal {
 
 [[nodiscard]]
 inline std::string _testFmt(
-    const ColorText& tag,
+    const RenderedText& tag,
     std::string_view expr,
-    ProString& desc,
+    const ProString& desc,
     const SourceLoc& loc
 ) noexcept {
     return desc.isEmpty()
@@ -40,22 +57,82 @@ inline std::string _testFmt(
         _TAG_COMM(tag),
         _TAG_COMM(loc),
         _TAG_COMM(_EXPR(expr)),
-        _DESC(desc.TEXT)
+        _DESC(desc.view())
     );
 }
 
+// Result of the `ZTEST_CASE` running on the calling thread
+struct TestRun {
+    std::string_view name     {};
+    std::string      output   {};  //< Captured log and check lines
+    uint32_t         failures {0};
+};
+
+inline thread_local TestRun *s_test_run = nullptr;
+
+// Serializes the output of `runTests` workers
+[[nodiscard]]
+inline std::mutex &_testPrintMutex() noexcept
+{
+    static std::mutex s_mutex {};
+    return s_mutex;
+}
+
+// Count a failed check against the running case, if any
+inline void _failCheck() noexcept
+{
+    if (s_test_run) ++s_test_run->failures;
+}
+
+// Print the running case as failed with its captured output before a fatal check ends the
+// process (outside `ZLOG_T`, where `runTests` never gets to report it)
+inline void _abortRun() noexcept
+{
+#ifndef ZLOG_T
+    TestRun *run = s_test_run;
+    if (!run) return;
+
+    s_capture  = nullptr;
+    s_test_run = nullptr;
+
+    std::scoped_lock<std::mutex> lock {_testPrintMutex()};
+    std::cout << std::format(
+        "{}{}{}{}{} (aborted the run)\n",
+        _TAG_COMM(config::rendered::TEST_TAG),
+        _TAG_COMM(config::rendered::FAIL_TAG),
+        _DESC(run->name)
+    ) << run->output << std::flush;
+#endif
+}
+
 } // namespace internal
 
 /// Unit test assertion (always runs in tests)
 
 inline void test(bool condition, std::string_view expr, internal::ProString desc) noexcept
 {
+    // Inside `runTests`, the line goes to the case's output
+    if (internal::TestRun *run = internal::s_test_run)
+    {
+        if (!condition) ++run->failures;
+
+        run->output += std::format(
+            "{}{}{}{}{}{}{}\n",
+            _TAG_COMM(config::rendered::TEST_TAG),
+            _TAG_COMM(condition ? config::rendered::PASS_TAG : config::rendered::FAIL_TAG),
+            _EXPR(expr),
+            desc.isEmpty() ? "" : config::TAG_TAG,
+            _DESC(desc.view())
+        );
+        return;
+    }
+
     ZOUT
-    << _TAG_OS(config::TEST_TAG)
-    << _TAG_OS(condition ? config::PASS_TAG : config::FAIL_TAG)
+    << _TAG_OS(config::rendered::TEST_TAG)
+    << _TAG_OS(condition ? config::rendered::PASS_TAG : config::rendered::FAIL_TAG)
     << _EXPR(expr)
     << (desc.isEmpty() ? "" : config::TAG_TAG)
-    << _DESC(desc.TEXT);
+    << _DESC(desc.view());
 }
 
 /// expectation (non-fatal, always runs)
@@ -67,7 +144,8 @@ inline void expect(
 ) noexcept
 {
     if (condition) return;
-    ZWARN(internal::_testFmt(config::EXPECT_TAG, expr, desc, loc));
+    internal::_failCheck();
+    ZWARN(internal::_testFmt(config::rendered::EXPECT_TAG, expr, desc, loc));
 }
 
 /// assertion (fatal, only in debug builds)
@@ -81,7 +159,9 @@ inline void assert(
 #ifndef NDEBUG
     if constexpr (!config::IS_MODE_DEBUG) return; // only on debug
     if (condition) return;
-    ZERR(internal::_testFmt(config::ASSERT_TAG, expr, desc, loc));
+    internal::_failCheck();
+    ZERR(internal::_testFmt(config::rendered::ASSERT_TAG, expr, desc, loc));
+    internal::_abortRun();
     config::killProcess();
 #endif
 }
@@ -95,7 +175,9 @@ inline void verify(
 ) noexcept
 {
     if (condition) return;
-    ZFATAL(internal::_testFmt(config::VERIFY_TAG, expr, desc, loc));
+    internal::_failCheck();
+    ZFATAL(internal::_testFmt(config::rendered::VERIFY_TAG, expr, desc, loc));
+    internal::_abortRun();
     config::killProcess();
 }
 
@@ -105,14 +187,407 @@ inline void verify(
 #endif
 inline void panic(internal::ProString desc, SourceLoc loc = {}) noexcept
 {
+    internal::_failCheck();
+
     if (desc.isEmpty())
-        ZFATAL("{}{}{}", _TAG_COMM(config::PANIC_TAG), loc);
+        ZFATAL("{}{}{}", _TAG_COMM(config::rendered::PANIC_TAG), loc);
     else
-        ZFATAL("{}{}{}{}{}", _TAG_COMM(config::PANIC_TAG), _TAG_COMM(loc), _DESC(desc.TEXT));
+        ZFATAL("{}{}{}{}{}", _TAG_COMM(config::rendered::PANIC_TAG), _TAG_COMM(loc), _DESC(desc.view()));
 
+    internal::_abortRun();
     config::killProcess();
 }
 
+/// Test cases
+
+// One `ZTEST_CASE`, constant-initialized and registered before `main`
+struct TestCase {
+    const std::string_view NAME;
+    const SourceLoc        LOC;
+    void           (*const FN)();
+    TestCase              *next {nullptr};  //< Registry link
+};
+
+namespace internal {
+
+// Head of the registered cases (intrusive list, most recent first)
+inline constinit TestCase *s_test_head = nullptr;
+
+// Link `test` into the registry (static initialization, single-threaded)
+inline bool registerTest(TestCase &test) noexcept
+{
+    test.next = s_test_head;
+    s_test_head = &test;
+    return true;
+}
+
+// Run `test` with its checks counted and its log lines captured into `run`
+inline void _runCase(const TestCase &test, TestRun &run) noexcept
+{
+    run.name   = test.NAME;
+    s_test_run = &run;
+    s_capture  = &run.output;
+
+    try { test.FN(); }
+    catch (const std::exception &error)
+    {
+        ++run.failures;
+        ZERR("{}{}uncaught exception: {}", _TAG_COMM(test.LOC), error.what());
+    }
+    catch (...)
+    {
+        ++run.failures;
+        ZERR("{}{}uncaught exception", _TAG_COMM(test.LOC));
+    }
+
+    s_capture  = nullptr;
+    s_test_run = nullptr;
+}
+
+} // namespace internal
+
+// Run the cases whose name contains `filter` on `jobs` threads (one per hardware thread if 0),
+// printing each case with its time and captured output as it ends, then a summary;
+// returns 0 if every case passed, 1 otherwise
+//
+// Outside `ZLOG_T` a failing `ZASSERT`, `ZVERIFY` or `ZPANIC` still ends the process: its case
+// is printed as failed with its output first, but no summary follows
+inline int runTests(std::string_view filter = {}, size_t jobs = 0)
+{
+    std::vector<const TestCase *> cases {};
+
+    for (const TestCase *test = internal::s_test_head; test; test = test->next)
+        if (test->NAME.find(filter) != std::string_view::npos) cases.push_back(test);
+
+    std::ranges::reverse(cases);  // Registration order
+
+    if (jobs == 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::max<size_t>(1, std::min(jobs, cases.size()));
+
+    std::atomic<size_t>           next   {0};
+    std::vector<const TestCase *> failed {};  //< Guarded by `_testPrintMutex()`
+
+    const auto worker = [&] {
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < cases.size();
+             i = next.fetch_add(1, std::memory_order_relaxed))
+        {
+            const TestCase &test = *cases[i];
+            internal::TestRun run {};
+
+            const auto start = std::chrono::steady_clock::now();
+            internal::_runCase(test, run);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            const bool passed = run.failures == 0;
+            const std::string header = std::format(
+                "{}{}{}{}{} ({:.3f} ms)\n",
+                _TAG_COMM(config::rendered::TEST_TAG),
+                _TAG_COMM(passed ? config::rendered::PASS_TAG : config::rendered::FAIL_TAG),
+                _DESC(test.NAME),
+                elapsed.count()
+            );
+
+            std::scoped_lock<std::mutex> lock {internal::_testPrintMutex()};
+            if (!passed) failed.push_back(&test);
+            std::cout << header << run.output << std::flush;
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> pool {};
+    for (size_t i = 1; i < jobs; ++i) pool.emplace_back(worker);
+    worker();
+    for (std::thread &thread : pool) thread.join();
+
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << std::format(
+        "{}{}{} passed, {} failed in {:.3f} ms ({} jobs)\n",
+        _TAG_COMM(config::rendered::TEST_TAG),
+        cases.size() - failed.size(),
+        failed.size(),
+        elapsed.count(),
+        jobs
+    );
+
+    for (const TestCase *test : failed)
+        std::cout << std::format("{}{}{}{}{}\n", _TAG_COMM(config::rendered::FAIL_TAG), _TAG_COMM(test->LOC), _DESC(test->NAME));
+
+    std::cout << std::flush;
+    return failed.empty() ? 0 : 1;
+}
+
+// `runTests` with "--filter=TEXT" (or a bare TEXT) and "--jobs=N" from the command line
+inline int runTests(int argc, char **argv)
+{
+    std::string_view filter {};
+    size_t jobs = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+
+        if      (arg.starts_with("--filter=")) filter = arg.substr(9);
+        else if (arg.starts_with("--jobs="))   jobs   = std::strtoull(argv[i] + 7, nullptr, 10);
+        else if (!arg.starts_with("--"))       filter = arg;  // Other options belong to `runBenchmarks`
+    }
+
+    return runTests(filter, jobs);
+}
+
+/// Micro-benchmarks
+
+// Keeps `value`, and the computation producing it, from being optimized away
+template <typename T>
+inline void doNotOptimize(const T &value) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    if constexpr (std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(void *))
+        asm volatile("" : : "r"(value) : "memory");
+    else
+        asm volatile("" : : "m"(value) : "memory");
+#else
+    static const void *volatile s_escape = nullptr;
+    s_escape = &value;
+#endif
+}
+
+// Makes every pending memory write observable, so stores are not optimized away
+inline void clobberMemory() noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// One `ZBENCH`, registered before `main`, `RUN(n)` runs its body `n` times
+struct BenchCase {
+    const std::string_view NAME;
+    const SourceLoc        LOC;
+    void           (*const RUN)(uint64_t);
+    BenchCase             *next {nullptr};  //< Registry link
+};
+
+// Statistics of one benchmark, times are per iteration
+struct BenchStats {
+    double   mean     {0};
+    double   median   {0};
+    double   stddev   {0};
+    double   min      {0};
+    double   max      {0};
+    uint64_t iters    {0};  //< Iterations per sample
+    uint32_t samples  {0};
+    uint32_t outliers {0};  //< Samples outside 1.5 IQR of the quartiles
+};
+
+// Options of `runBenchmarks`
+struct BenchOptions {
+    std::string_view filter    {};         //< Run only benchmarks whose name contains this
+    const char      *baseline  {nullptr};  //< Compare medians against this file
+    const char      *save      {nullptr};  //< Write the medians to this file
+    double           threshold {config::BENCH_REGRESSION};
+};
+
+namespace internal {
+
+// Head of the registered benchmarks (intrusive list, most recent first)
+inline constinit BenchCase *s_bench_head = nullptr;
+
+// Link `bench` into the registry (static initialization, single-threaded)
+inline bool registerBench(BenchCase &bench) noexcept
+{
+    bench.next = s_bench_head;
+    s_bench_head = &bench;
+    return true;
+}
+
+// Nanoseconds taken by `iters` runs of `bench`
+[[nodiscard]]
+inline double _timeBench(const BenchCase &bench, uint64_t iters)
+{
+    const auto start = std::chrono::steady_clock::now();
+    bench.RUN(iters);
+    return std::chrono::duration<double, std::nano>{std::chrono::steady_clock::now() - start}.count();
+}
+
+// Warm up, calibrate the iterations of one sample to `BENCH_SAMPLE_US`, then sample
+[[nodiscard]]
+inline BenchStats _measure(const BenchCase &bench)
+{
+    constexpr double SAMPLE_NS = config::BENCH_SAMPLE_US * 1e3;
+    constexpr double WARMUP_NS = config::BENCH_WARMUP_MS * 1e6;
+    constexpr uint64_t MAX_ITERS = uint64_t{1} << 40;
+
+    uint64_t iters = 1;
+
+    for (double warm = 0; warm < WARMUP_NS;) warm += _timeBench(bench, iters);
+
+    while (true)
+    {
+        const double ns = _timeBench(bench, iters);
+
+        if (ns >= SAMPLE_NS / 10 || iters >= MAX_ITERS)  // A body optimized away never gets there
+        {
+            iters = std::clamp<uint64_t>(static_cast<uint64_t>(iters * (SAMPLE_NS / std::max(ns, 1.0))), 1, MAX_ITERS);
+            break;
+        }
+
+        iters *= (ns < SAMPLE_NS / 1000) ? 10 : 2;
+    }
+
+    std::vector<double> times (std::max<uint32_t>(config::BENCH_SAMPLES, 1));
+    for (double &time : times) time = _timeBench(bench, iters) / static_cast<double>(iters);
+
+    std::ranges::sort(times);
+
+    const size_t n = times.size();
+    BenchStats stats {.min = times.front(), .max = times.back(), .iters = iters, .samples = static_cast<uint32_t>(n)};
+
+    stats.median = (n % 2) ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+
+    for (const double time : times) stats.mean += time;
+    stats.mean /= static_cast<double>(n);
+
+    for (const double time : times) stats.stddev += (time - stats.mean) * (time - stats.mean);
+    stats.stddev = (n > 1) ? std::sqrt(stats.stddev / static_cast<double>(n - 1)) : 0.0;
+
+    // Tukey's fences
+    const double q1 = times[n / 4], q3 = times[(3 * n) / 4];
+    const double iqr = q3 - q1;
+
+    for (const double time : times)
+        if (time < q1 - 1.5 * iqr || time > q3 + 1.5 * iqr) ++stats.outliers;
+
+    return stats;
+}
+
+// "12.34 ns", "1.20 us", ...
+[[nodiscard]]
+inline std::string _formatNs(double ns)
+{
+    if (ns < 1e3) return std::format("{:.2f} ns", ns);
+    if (ns < 1e6) return std::format("{:.2f} us", ns / 1e3);
+    if (ns < 1e9) return std::format("{:.2f} ms", ns / 1e6);
+    return std::format("{:.2f} s", ns / 1e9);
+}
+
+// "name median_ns" lines of a baseline file, empty if it cannot be read
+[[nodiscard]]
+inline std::vector<std::pair<std::string, double>> _loadBaseline(const char *path)
+{
+    std::vector<std::pair<std::string, double>> entries {};
+    std::ifstream file {path};
+
+    std::string name {};
+    double median = 0;
+    while (file >> name >> median) entries.emplace_back(std::move(name), median);
+
+    return entries;
+}
+
+} // namespace internal
+
+// Run the benchmarks whose name contains `opt.filter` one after another, printing their
+// statistics; with a baseline, medians slower than it by more than `opt.threshold` fail;
+// returns 0 if none regressed, 1 otherwise
+inline int runBenchmarks(const BenchOptions &opt = {})
+{
+    std::vector<const BenchCase *> benches {};
+
+    for (const BenchCase *bench = internal::s_bench_head; bench; bench = bench->next)
+        if (bench->NAME.find(opt.filter) != std::string_view::npos) benches.push_back(bench);
+
+    std::ranges::reverse(benches);  // Registration order
+
+    const auto baseline = opt.baseline ? internal::_loadBaseline(opt.baseline) : decltype(internal::_loadBaseline("")){};
+
+    if (opt.baseline && baseline.empty())
+        ZWARN("{}{}no baseline read from '{}'", _TAG_COMM(config::rendered::BENCH_TAG), opt.baseline);
+
+    std::vector<std::pair<std::string_view, double>> medians {};
+    size_t regressed = 0;
+
+    for (const BenchCase *bench : benches)
+    {
+        const BenchStats stats = internal::_measure(*bench);
+        medians.emplace_back(bench->NAME, stats.median);
+
+        std::string line = std::format(
+            "{}{}{}{}median {}, mean {} +/- {}, min {} ({} x {} iters, {} outliers)",
+            _TAG_COMM(config::rendered::BENCH_TAG),
+            _TAG_COMM(_DESC(bench->NAME)),
+            internal::_formatNs(stats.median),
+            internal::_formatNs(stats.mean),
+            internal::_formatNs(stats.stddev),
+            internal::_formatNs(stats.min),
+            stats.samples,
+            stats.iters,
+            stats.outliers
+        );
+
+        const auto base = std::ranges::find(baseline, bench->NAME, [](const auto &entry) { return std::string_view{entry.first}; });
+
+        if (base != baseline.end() && base->second > 0)
+        {
+            const double change = stats.median / base->second - 1.0;
+            const bool   failed = change > opt.threshold;
+
+            if (failed) ++regressed;
+
+            line += std::format(
+                "{}{}{}{:+.1f}% vs baseline {}",
+                config::TAG_TAG,
+                _TAG_COMM(failed ? config::rendered::FAIL_TAG : config::rendered::PASS_TAG),
+                change * 100,
+                internal::_formatNs(base->second)
+            );
+        }
+
+        std::cout << line << '\n' << std::flush;
+    }
+
+    if (opt.save)
+    {
+        std::ofstream file {opt.save};
+        for (const auto &[name, median] : medians) file << name << ' ' << std::format("{:.4f}", median) << '\n';
+
+        if (!file) ZWARN("{}{}cannot write baseline '{}'", _TAG_COMM(config::rendered::BENCH_TAG), opt.save);
+    }
+
+    std::cout << std::format(
+        "{}{}{} benchmarks, {} regressed (threshold {:.1f}%)\n",
+        _TAG_COMM(config::rendered::BENCH_TAG),
+        benches.size(),
+        regressed,
+        opt.threshold * 100
+    ) << std::flush;
+
+    return regressed == 0 ? 0 : 1;
+}
+
+// `runBenchmarks` with "--filter=TEXT" (or a bare TEXT), "--baseline=PATH", "--save=PATH"
+// and "--threshold=0.1" from the command line
+inline int runBenchmarks(int argc, char **argv)
+{
+    BenchOptions opt {};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+
+        if      (arg.starts_with("--filter="))    opt.filter    = arg.substr(9);
+        else if (arg.starts_with("--baseline="))  opt.baseline  = argv[i] + 11;
+        else if (arg.starts_with("--save="))      opt.save      = argv[i] + 7;
+        else if (arg.starts_with("--threshold=")) opt.threshold = std::strtod(argv[i] + 12, nullptr);
+        else if (!arg.starts_with("--"))          opt.filter    = arg;  // Other options belong to `runTests`
+    }
+
+    return runBenchmarks(opt);
+}
+
 #undef _TAG_OS
 #undef _TAG_COMM
 #undef _EXPR
@@ -123,10 +598,44 @@ inline void panic(internal::ProString desc, SourceLoc loc = {}) noexcept
 
 /// MACROS:
 
+// Evaluates `COND` first, the description and location are only built on the
+// cold failure path, so passing checks cost a single branch
+#define _ZCHECK(FN, COND, EXPR, ...) do {                                 \
+    if (static_cast<bool>(COND)) [[likely]] {}                            \
+    else                                                                  \
+    {                                                                     \
+        constexpr ::zlog::SourceLoc _zlog_loc = _ZSL;                     \
+        [&] [[gnu::cold, gnu::noinline]] () {                             \
+            ::zlog::FN(false, (EXPR), {__VA_ARGS__}, _zlog_loc);          \
+        }();                                                              \
+    }                                                                     \
+} while (0)
+
 #define   ZTEST(COND, ...)  do { ::zlog::test  ((COND), (#COND), {__VA_ARGS__}      ); } while (0)
-#define ZEXPECT(COND, ...)  do { ::zlog::expect((COND), (#COND), {__VA_ARGS__}, _ZSL); } while (0)
-#define ZASSERT(COND, ...)  do { ::zlog::assert((COND), (#COND), {__VA_ARGS__}, _ZSL); } while (0)
-#define ZVERIFY(COND, ...)  do { ::zlog::verify((COND), (#COND), {__VA_ARGS__}, _ZSL); } while (0)
+#define ZEXPECT(COND, ...)  _ZCHECK(expect, (COND), (#COND), __VA_ARGS__)
+#define ZASSERT(COND, ...)  _ZCHECK(assert, (COND), (#COND), __VA_ARGS__)
+#define ZVERIFY(COND, ...)  _ZCHECK(verify, (COND), (#COND), __VA_ARGS__)
 
 #define    ZPANIC(...)        do {           ::zlog::panic({__VA_ARGS__}, _ZSL); } while (0)
-#define ZPANIC_IF(COND, ...)  do { if (COND) ::zlog::panic({__VA_ARGS__}, _ZSL); } while (0)
+#define ZPANIC_IF(COND, ...)  do { if (COND) [[unlikely]] ::zlog::panic({__VA_ARGS__}, _ZSL); } while (0)
+
+// Defines and registers a test case, run by `zlog::runTests`: `ZTEST_CASE(parse) { ZTEST(...); }`
+#define ZTEST_CASE(NAME)                                                                        \
+    static void _zlog_test_##NAME();                                                            \
+    static constinit ::zlog::TestCase _zlog_test_case_##NAME {#NAME, _ZSL, _zlog_test_##NAME};  \
+    [[maybe_unused]] static const bool _zlog_test_reg_##NAME =                                  \
+        ::zlog::internal::registerTest(_zlog_test_case_##NAME);                                 \
+    static void _zlog_test_##NAME()
+
+// Defines and registers a micro-benchmark, run by `zlog::runBenchmarks`; the body is one
+// iteration, inlined into the timed loop: `ZBENCH(parse) { zlog::doNotOptimize(parse(text)); }`
+#define ZBENCH(NAME)                                                                                    \
+    static void _zlog_bench_##NAME();                                                                   \
+    static void _zlog_bench_loop_##NAME(uint64_t iters)                                                 \
+    {                                                                                                   \
+        for (uint64_t i = 0; i < iters; ++i) _zlog_bench_##NAME();                                      \
+    }                                                                                                   \
+    static constinit ::zlog::BenchCase _zlog_bench_case_##NAME {#NAME, _ZSL, _zlog_bench_loop_##NAME};  \
+    [[maybe_unused]] static const bool _zlog_bench_reg_##NAME =                                         \
+        ::zlog::internal::registerBench(_zlog_bench_case_##NAME);                                       \
+    static void _zlog_bench_##NAME()
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "./config.hpp"
+#include "./timestamp.hpp"
+
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+namespace zlog {
+
+namespace internal {
+
+// Appends `text` to `out` as the contents of a JSON string, runs of characters
+// that need no escaping are copied at once
+inline void putJsonEscaped(std::string &out, std::string_view text)
+{
+    static constexpr char HEX[] = "0123456789abcdef";
+
+    size_t run = 0;
+
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        const auto ch = static_cast<unsigned char>(text[i]);
+        if (ch >= 0x20 && ch != '"' && ch != '\\') continue;
+
+        out.append(text.data() + run, i - run);
+        run = i + 1;
+
+        switch (ch)
+        {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n";  break;
+        case '\r': out += "\\r";  break;
+        case '\t': out += "\\t";  break;
+        default:
+            out += "\\u00";
+            out += HEX[ch >> 4];
+            out += HEX[ch & 0xF];
+        }
+    }
+
+    out.append(text.data() + run, text.size() - run);
+}
+
+// Nanoseconds since `s_start_time`
+[[nodiscard]]
+inline uint64_t monotonicNanos() noexcept
+{
+    const auto elapsed = std::chrono::steady_clock::now() - s_start_time;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+// One completed scope
+struct TimelineEvent {
+    uint64_t start_ns;  //< Since `s_start_time`
+    uint64_t dur_ns;
+    uint32_t name_pos;  //< Offset of the name in the thread's `names`
+    uint32_t name_len;
+    uint32_t depth;     //< Nesting depth on its thread
+};
+
+// Completed scopes of every thread, exported as Chrome Trace Event JSON
+class Timeline final {
+    // Per-thread events
+    struct ThreadEvents {
+        std::mutex                 mutex   {};  //< Only contended by exports
+        std::vector<TimelineEvent> events  {};
+        std::string                names   {};  //< Scope names, referenced by the events
+        uint64_t                   dropped {0};  //< Events past `config::TIMELINE_CAPACITY`
+        uint32_t                   tid     {0};
+
+        ThreadEvents()
+        {
+            events.reserve(1024);
+            tid = instance()._attach(this);
+        }
+
+        ~ThreadEvents()
+        {
+            instance()._detach(this);
+        }
+    };
+
+    std::mutex                  mutex    {};  //< Guards the registry and `retired`
+    uint32_t                    next_tid {1};
+    std::vector<ThreadEvents *> threads  {};
+    std::string                 retired  {};  //< Rendered events of exited threads
+
+    inline static thread_local bool     s_destroyed = false;
+    inline static thread_local uint32_t s_depth     = 0;
+
+    Timeline() = default;
+
+    uint32_t _attach(ThreadEvents *local)
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        threads.push_back(local);
+        return next_tid++;
+    }
+
+    void _detach(ThreadEvents *local) noexcept
+    {
+        std::scoped_lock<std::mutex> lock {mutex};
+        _render(retired, *local);
+        std::erase(threads, local);
+        s_destroyed = true;
+    }
+
+    // Calling thread's events, nullptr once destroyed at thread exit
+    [[nodiscard]]
+    static ThreadEvents *_local() noexcept
+    {
+        if (s_destroyed) return nullptr;
+
+        thread_local ThreadEvents s_events {};
+        return &s_events;
+    }
+
+    // Append the JSON objects of a thread's events to `out`, each followed by a comma
+    static void _render(std::string &out, ThreadEvents &local)
+    {
+        std::scoped_lock<std::mutex> lock {local.mutex};
+        auto it = std::back_inserter(out);
+
+        for (const TimelineEvent &event : local.events)
+        {
+            out += R"({"name":")";
+            putJsonEscaped(out, std::string_view{local.names}.substr(event.name_pos, event.name_len));
+            std::format_to(
+                it,
+                R"(","cat":"zlog","ph":"X","pid":1,"tid":{},"ts":{}.{:03},"dur":{}.{:03},"args":{{"depth":{}}}}},)",
+                local.tid,
+                event.start_ns / 1000, event.start_ns % 1000,
+                event.dur_ns / 1000, event.dur_ns % 1000,
+                event.depth
+            );
+            out += '\n';
+        }
+
+        if (local.dropped > 0)
+        {
+            std::format_to(
+                it,
+                R"({{"name":"zlog: {} events dropped","ph":"i","s":"t","pid":1,"tid":{},"ts":0}},)",
+                local.dropped, local.tid
+            );
+            out += '\n';
+        }
+
+        local.events.clear();
+        local.names.clear();
+        local.dropped = 0;
+    }
+
+public:
+    Timeline(const Timeline&) = delete;
+    Timeline &operator=(const Timeline&) = delete;
+
+    // Process-wide timeline, never destroyed so it outlives thread exit; written to
+    // `config::TIMELINE_PATH` at exit
+    [[nodiscard]]
+    static Timeline &instance() noexcept
+    {
+        static Timeline *s_timeline = [] {
+            Timeline *timeline = new Timeline{};
+            std::atexit([] { instance().write(config::TIMELINE_PATH); });
+            return timeline;
+        }();
+
+        return *s_timeline;
+    }
+
+    // Enter a scope on the calling thread, returns its depth
+    [[nodiscard]]
+    static uint32_t enter() noexcept { return s_depth++; }
+
+    // Leave the scope entered at `start_ns` and record it
+    static void leave(std::string_view name, uint64_t start_ns, uint32_t depth) noexcept
+    {
+        const uint64_t end_ns = monotonicNanos();
+        s_depth = depth;
+
+        ThreadEvents *local = _local();
+        if (!local) return;
+
+        std::scoped_lock<std::mutex> lock {local->mutex};
+
+        if (local->events.size() >= config::TIMELINE_CAPACITY)
+        {
+            ++local->dropped;
+            return;
+        }
+
+        local->events.push_back({
+            start_ns, end_ns - start_ns,
+            static_cast<uint32_t>(local->names.size()), static_cast<uint32_t>(name.size()),
+            depth
+        });
+        local->names.append(name);
+    }
+
+    // Move every recorded event into a Chrome Trace Event JSON document
+    [[nodiscard]]
+    std::string json()
+    {
+        std::string out {R"({"displayTimeUnit":"ns","traceEvents":[)" "\n"};
+
+        {
+            std::scoped_lock<std::mutex> lock {mutex};
+            out += retired;
+            retired.clear();
+            for (ThreadEvents *local : threads) _render(out, *local);
+        }
+
+        if (out.ends_with(",\n")) out.erase(out.size() - 2, 1);
+        out += "]}\n";
+        return out;
+    }
+
+    // Write (and clear) the recorded events to `path`, false if nothing was recorded or on error
+    bool write(const char *path)
+    {
+        const std::string text = json();
+        if (text.find(R"("ph":)") == std::string::npos) return false;
+
+        std::FILE *file = std::fopen(path, "wb");
+        if (!file) return false;
+
+        const bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+        return (std::fclose(file) == 0) && ok;
+    }
+};
+
+} // namespace internal
+
+// Write the recorded scope timeline to `path` as Chrome Trace / Perfetto JSON
+inline bool writeTimeline(const char *path = config::TIMELINE_PATH)
+{
+    return internal::Timeline::instance().write(path);
+}
+
+} // namespace zlog
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "./config.hpp"
+
+#include <ctime>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <string_view>
+
+namespace zlog {
+
+namespace internal {
+
+// Writes `value` as exactly `width` zero padded digits
+constexpr void putDigits(char *out, uint64_t value, size_t width) noexcept
+{
+    for (size_t i = width; i > 0; --i)
+    {
+        out[i - 1] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+}
+
+// Reference point of `TimestampFormat::Monotonic`
+inline const std::chrono::steady_clock::time_point s_start_time = std::chrono::steady_clock::now();
+
+// Per-thread timestamp renderer, calendar fields are formatted once per second
+class TimestampCache final {
+    static constexpr TimestampFormat FORMAT = config::TIMESTAMP_FORMAT;
+
+    // Sub-second digits patched into every timestamp
+    static constexpr size_t FRACTION =
+        (FORMAT == TimestampFormat::ClockMillis) ? 3 :
+        (FORMAT == TimestampFormat::ClockMicros || FORMAT == TimestampFormat::Iso8601) ? 6 : 0;
+
+    char    buf[48]    {};
+    size_t  prefix_len {0};          //< Bytes before the fraction
+    size_t  total_len  {0};
+    int64_t cached_sec {INT64_MIN};  //< Unix second `buf` was rendered for
+
+    // Render the parts of `buf` that only change every second
+    void _renderSecond(int64_t sec) noexcept
+    {
+        const std::time_t t = static_cast<std::time_t>(sec);
+        std::tm tm_struct {};
+
+#ifdef _WIN32
+        localtime_s(&tm_struct, &t);
+#else
+        localtime_r(&t, &tm_struct);
+#endif
+
+        if constexpr (FORMAT == TimestampFormat::Iso8601)
+        {
+            prefix_len = std::strftime(buf, sizeof(buf), "[%Y-%m-%dT%H:%M:%S.", &tm_struct);
+            total_len  = prefix_len + FRACTION;
+            total_len += std::strftime(buf + total_len, sizeof(buf) - total_len, "%z]", &tm_struct);
+        }
+        else
+        {
+            prefix_len = std::strftime(buf, sizeof(buf), FRACTION ? "[%H:%M:%S." : "[%H:%M:%S", &tm_struct);
+            total_len  = prefix_len + FRACTION;
+            buf[total_len++] = ']';
+        }
+
+        cached_sec = sec;
+    }
+
+    // "[<integer>.<micros>]" style timestamps that need no calendar
+    std::string_view _renderCounter(std::string_view lead, uint64_t whole, uint64_t micros, bool fraction) noexcept
+    {
+        std::memcpy(buf, lead.data(), lead.size());
+        char *end = std::to_chars(buf + lead.size(), buf + sizeof(buf) - 8, whole).ptr;
+
+        if (fraction)
+        {
+            *end++ = '.';
+            putDigits(end, micros, 6);
+            end += 6;
+        }
+
+        *end++ = ']';
+        return std::string_view{buf, static_cast<size_t>(end - buf)};
+    }
+
+public:
+    // Current timestamp, valid until the next call on this thread
+    [[nodiscard]]
+    std::string_view get() noexcept
+    {
+        using namespace std::chrono;
+
+        if constexpr (FORMAT == TimestampFormat::Monotonic)
+        {
+            const auto us = duration_cast<microseconds>(steady_clock::now() - s_start_time).count();
+            return _renderCounter("[+", static_cast<uint64_t>(us / 1'000'000), static_cast<uint64_t>(us % 1'000'000), true);
+        }
+
+        const int64_t ns = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+
+        if constexpr (FORMAT == TimestampFormat::EpochNanos)
+        {
+            return _renderCounter("[", static_cast<uint64_t>(ns), 0, false);
+        }
+        else
+        {
+            const int64_t sec = (ns >= 0) ? ns / 1'000'000'000 : (ns - 999'999'999) / 1'000'000'000;
+            if (sec != cached_sec) _renderSecond(sec);
+
+            if constexpr (FRACTION > 0)
+            {
+                const auto sub_ns = static_cast<uint64_t>(ns - sec * 1'000'000'000);
+                putDigits(buf + prefix_len, sub_ns / (FRACTION == 3 ? 1'000'000 : 1'000), FRACTION);
+            }
+
+            return std::string_view{buf, total_len};
+        }
+    }
+};
+
+// Returns the current timestamp in `config::TIMESTAMP_FORMAT`
+[[nodiscard]]
+inline std::string_view getTimestamp() noexcept
+{
+    thread_local TimestampCache s_cache {};
+    return s_cache.get();
+}
+
+} // namespace internal
+
+} // namespace zlog
@@ -86,8 +86,29 @@ inline void critical(
 #define   ZON_DEBUG  if constexpr ( ::zlog::config::IS_MODE_DEBUG)
 #define ZON_RELEASE  if constexpr (!::zlog::config::IS_MODE_DEBUG)
 
-#define  ZCAUTION(code, ...)  do { ::zlog::caution (code, _ZSL, {__VA_ARGS__}); } while (0)
-#define ZCRITICAL(code, ...)  do { ::zlog::critical(code, _ZSL, {__VA_ARGS__}); } while (0)
+// Caution and critical call sites are counted like log sites, critical sites
+// ignore `LogSite::enabled` and rate limits since they always terminate
+#define  ZCAUTION(code, ...)  do {                                     \
+    if constexpr (::zlog::internal::isEnabled(::zlog::LogLevel::Warn))   \
+    {                                                                    \
+        static constinit ::zlog::LogSite _zlog_site {                    \
+            ::zlog::LogLevel::Warn, _ZSL,                                \
+            ::zlog::internal::siteFormat(#__VA_ARGS__), "ZCAUTION"       \
+        };                                                               \
+        if (::zlog::internal::hitSite(_zlog_site))                       \
+            ::zlog::caution(code, _zlog_site.LOC, {__VA_ARGS__});        \
+    }                                                                    \
+} while (0)
+
+#define ZCRITICAL(code, ...)  do {                                     \
+    static constinit ::zlog::LogSite _zlog_site {                        \
+        ::zlog::LogLevel::Fatal, _ZSL,                                   \
+        ::zlog::internal::siteFormat(#__VA_ARGS__), "ZCRITICAL",         \
+        ::zlog::NO_LIMIT                                                 \
+    };                                                                   \
+    ::zlog::internal::hitSite(_zlog_site);                               \
+    ::zlog::critical(code, _zlog_site.LOC, {__VA_ARGS__});               \
+} while (0)
 
 #define        ZTODO(...)  ZCAUTION(::zlog::CautionCode::Todo        , __VA_ARGS__)
 #define  ZDEPRECATED(...)  ZCAUTION(::zlog::CautionCode::Deprecated  , __VA_ARGS__)
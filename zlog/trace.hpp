@@ -2,38 +2,118 @@
 
 #include "./config.hpp"
 #include "./log.hpp"
+#include "./timeline.hpp"
+#include "./profiler.hpp"
 
 #include <format>
-#include <string>
+#include <cstdint>
+#include <utility>
+#include <string_view>
 
 namespace zlog {
 
-// Uses RAII to log tracing messages of a scope
+// Uses RAII to log tracing messages of a scope (and time it with `config::ENABLE_TIMELINE`
+// or `config::ENABLE_PROFILER`)
 struct ScopeTracer {
 private:
-    const std::string STR_TEXT;  //< Owned tracing message
+    // Trace lines are logged or scopes are recorded in the timeline (both need the text)
+    static constexpr bool ACTIVE = internal::isEnabled(LogLevel::Trace) || config::ENABLE_TIMELINE;
 
-public:
-    const ColorText TEXT;  //< Colored tracing message
+    // Scope duration is measured
+    static constexpr bool TIMED = config::ENABLE_TIMELINE || config::ENABLE_PROFILER;
+
+    LogSite            *site     {nullptr};  //< Call site data (profiled if set)
+    bool                enabled  {true};     //< False if the call site is disabled
+    internal::ProString text;                //< Owned tracing message (empty if inactive)
+    uint64_t            start_ns {0};        //< Enter time
+    uint32_t            depth    {0};        //< Timeline nesting depth
 
-    // Scope IN
-    explicit ScopeTracer(internal::ProString text)
-        : STR_TEXT{std::move(text.TEXT)}
-        , TEXT{STR_TEXT, (config::ENABLE_TRACE_DULL) ? ANSI::EX_Black : ANSI::Reset}
+    // Count a hit of the call site, false if it is disabled or was not sampled (nullptr)
+    bool _hit(LogSite *site) noexcept
+    {
+        if constexpr (ACTIVE || TIMED)
+        {
+            if (site && internal::hitSite(*site)) this->site = site;
+            else enabled = false;
+        }
+
+        return enabled;
+    }
+
+    // Log `tag` followed by the tracing message
+    void _trace(const RenderedText &tag) const
     {
         internal::_log(
             LogLevel::Trace,
-            {"{}{}{}", config::TRACE_IN_TAG, config::TAG_TAG, TEXT}
+            {
+                "{}{}{}", tag, config::TAG_TAG,
+                ColorText{text.view(), (config::ENABLE_TRACE_DULL) ? ANSI::EX_Black : ANSI::Reset}
+            }
         );
     }
 
-    // Scope OUT
+    // Log the IN line, then start timing
+    void _enter()
+    {
+        if constexpr (internal::isEnabled(LogLevel::Trace)) _trace(config::rendered::TRACE_IN_TAG);
+        if constexpr (config::ENABLE_TIMELINE) depth = internal::Timeline::enter();
+        if constexpr (TIMED) start_ns = internal::monotonicNanos();
+    }
+
+public:
+    // Scope IN (regular string)
+    explicit ScopeTracer(std::string_view text)
+    {
+        if constexpr (ACTIVE)
+        {
+            this->text = text;
+            _enter();
+        }
+    }
+
+    // Scope IN (format string, formatted only if tracing or the timeline is enabled)
+    template <typename... Args>
+    explicit ScopeTracer(std::format_string<Args...> f_str, Args&&... args)
+    {
+        if constexpr (ACTIVE)
+        {
+            text = internal::ProString{f_str, std::forward<Args>(args)...};
+            _enter();
+        }
+    }
+
+    // Scope IN of a `ZTRC` call site (regular string), skipped if `site` is nullptr
+    ScopeTracer(LogSite *site, std::string_view text)
+    {
+        if (!_hit(site)) return;
+        if constexpr (ACTIVE) this->text = text;
+        _enter();
+    }
+
+    // Scope IN of a `ZTRC` call site (format string, formatted only if the text is used)
+    template <typename... Args>
+    ScopeTracer(LogSite *site, std::format_string<Args...> f_str, Args&&... args)
+    {
+        if (!_hit(site)) return;
+        if constexpr (ACTIVE) text = internal::ProString{f_str, std::forward<Args>(args)...};
+        _enter();
+    }
+
+    ScopeTracer(const ScopeTracer&) = delete;
+    ScopeTracer &operator=(const ScopeTracer&) = delete;
+
+    // Scope OUT (stops timing before logging)
     ~ScopeTracer()
     {
-        internal::_log(
-            LogLevel::Trace,
-            {"{}{}{}", config::TRACE_OUT_TAG, config::TAG_TAG, TEXT}
-        );
+        if (!enabled) return;
+
+        if constexpr (config::ENABLE_PROFILER)
+            if (site) internal::Profiler::instance().record(*site, internal::monotonicNanos() - start_ns);
+
+        if constexpr (config::ENABLE_TIMELINE) internal::Timeline::leave(text.view(), start_ns, depth);
+
+        if constexpr (internal::isEnabled(LogLevel::Trace))
+            _trace(config::rendered::TRACE_OUT_TAG);
     }
 };
 
@@ -41,10 +121,29 @@ public:
 
 /// MACROS:
 
-// For proper `ScopeTracer` construction
-#define _ZTRC_ANON  ::zlog::ScopeTracer ZTRACE_tracer_##__COUNTER__
+#define _ZCAT_IMPL(A, B)  A##B
+#define _ZCAT(A, B)       _ZCAT_IMPL(A, B)
+
+// Call site data and `ScopeTracer` of a traced scope, `ID` makes the names unique,
+// the scope is skipped unless `GATE` holds
+#define _ZTRC_SCOPE_ID(ID, GATE, NAME, ...)                                       \
+    static constinit ::zlog::LogSite _ZCAT(_zlog_scope_site_, ID) {               \
+        ::zlog::LogLevel::Trace, _ZSL, (NAME), "ZTRC", ::zlog::NO_LIMIT           \
+    };                                                                            \
+    ::zlog::ScopeTracer _ZCAT(_zlog_scope_, ID) {                                 \
+        (GATE) ? &_ZCAT(_zlog_scope_site_, ID) : nullptr, __VA_ARGS__             \
+    }
+
+#define _ZTRC_SCOPE(GATE, NAME, ...)  _ZTRC_SCOPE_ID(__COUNTER__, GATE, NAME, __VA_ARGS__)
 
 // Scope tracing
-#define ZTRC         _ZTRC_ANON { {     "{}()",       __FUNCTION__} }
-#define ZTRC_C(CLS)  _ZTRC_ANON { { "{}::{}()", #CLS, __FUNCTION__} }
-#define ZTRC_S(...)  _ZTRC_ANON { {__VA_ARGS__} }
+#define ZTRC         _ZTRC_SCOPE(true, _ZSL.FUNCTION,     "{}()",       __FUNCTION__)
+#define ZTRC_C(CLS)  _ZTRC_SCOPE(true, _ZSL.FUNCTION, "{}::{}()", #CLS, __FUNCTION__)
+#define ZTRC_S(...)  _ZTRC_SCOPE(true, ::zlog::internal::siteFormat(#__VA_ARGS__), __VA_ARGS__)
+
+// Sampled scope tracing, each run is traced (logged, timed and profiled) with probability `RATE`
+#define ZTRC_SAMPLED(RATE)         _ZTRC_SCOPE(::zlog::internal::sampled(RATE), _ZSL.FUNCTION,     "{}()",       __FUNCTION__)
+#define ZTRC_C_SAMPLED(RATE, CLS)  _ZTRC_SCOPE(::zlog::internal::sampled(RATE), _ZSL.FUNCTION, "{}::{}()", #CLS, __FUNCTION__)
+#define ZTRC_S_SAMPLED(RATE, ...)  _ZTRC_SCOPE(                                                         \
+    ::zlog::internal::sampled(RATE), ::zlog::internal::siteFormat(#__VA_ARGS__), __VA_ARGS__          \
+)